@@ -23,6 +23,12 @@
  * overflow interrupts, useful for periodic operations, time delays, or
  * cooperative task scheduling.
  *
+ * Overflow periods are powers of two of the CPU clock and only close to
+ * the named time (16 ms is 16.384 ms). Where the period must be exact,
+ * e.g. for a time base, use the CTC (clear timer on compare match)
+ * macros: the counter restarts at OCRnA and the compare A interrupt
+ * fires at exactly the named rate.
+ *
  * @note Based on Microchip Atmel ATmega328P manual.
  *       No separate source (.c) file is required.
  * @copyright (c) 2019-2025 Tomas Fryza, MIT license
@@ -137,6 +143,22 @@
  */
 #define tim0_ovf_disable() TIMSK0 &= ~(1<<TOIE0);
 
+/**
+ * @brief Timer0 in normal mode counting every 16 µs (prescaler = 256),
+ *        for compare match A events at a moving OCR0A; OC0A not used.
+ */
+#define tim0_compa_16us() TCCR0A = 0; TCCR0B = (1<<CS02);
+
+/**
+ * @brief Enable Timer0 compare match A interrupt (OCIE0A = 1).
+ */
+#define tim0_compa_enable() TIMSK0 |= (1<<OCIE0A);
+
+/**
+ * @brief Disable Timer0 compare match A interrupt (OCIE0A = 0).
+ */
+#define tim0_compa_disable() TIMSK0 &= ~(1<<OCIE0A);
+
 /** @} */
 
 
@@ -171,6 +193,23 @@
  */
 #define tim2_ovf_disable() TIMSK2 &= ~(1<<TOIE2);
 
+/**
+ * @brief Timer2 in CTC mode, compare match A every 1 ms exactly
+ *        (prescaler = 64, OCR2A = 249: 16 MHz / 64 / 250 = 1 kHz,
+ *        one count = 4 µs).
+ */
+#define tim2_ctc_1ms() TCCR2A = (1<<WGM21); OCR2A = 249; TCCR2B = (1<<CS22);
+
+/**
+ * @brief Enable Timer2 compare match A interrupt (OCIE2A = 1).
+ */
+#define tim2_compa_enable() TIMSK2 |= (1<<OCIE2A);
+
+/**
+ * @brief Disable Timer2 compare match A interrupt (OCIE2A = 0).
+ */
+#define tim2_compa_disable() TIMSK2 &= ~(1<<OCIE2A);
+
 /** @} */
 
 /** @} */
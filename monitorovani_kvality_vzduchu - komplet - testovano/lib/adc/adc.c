@@ -0,0 +1,468 @@
+/*
+ * ADC channel service for AVR-GCC.
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno board and ATmega328P, 16 MHz.
+ */
+
+// -- Includes ---------------------------------------------
+#include <adc.h>
+#include <systime.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+
+
+// -- Defines ----------------------------------------------
+#define ADC_NONE 0xff
+#define ADC_RING_MASK (ADC_RING_SIZE - 1)
+
+#if (ADC_RING_SIZE & ADC_RING_MASK) != 0
+# error "ADC_RING_SIZE must be a power of two"
+#endif
+#if ADC_MAX_CHANNELS > 8
+# error "ADC_MAX_CHANNELS must fit the 8-bit request mask"
+#endif
+
+
+// -- Local data -------------------------------------------
+
+/* Request table entry */
+typedef struct {
+    uint8_t mux;                        // ADC input
+    void (*callback)(void *arg, uint16_t value);    // Called with every result
+    void *arg;                          // Callback context
+    uint16_t ring[ADC_RING_SIZE];       // Last results
+    uint8_t head;                       // Next ring slot to write
+    uint8_t count;                      // Unread results in the ring
+    uint32_t stamp;                     // systime_ms() of the latest result
+} adc_channel_t;
+
+static adc_channel_t adc_channels[ADC_MAX_CHANNELS];
+static uint8_t adc_channel_count = 0;
+
+static uint8_t adc_timed = 0;               // Timed channels, bit per id
+static uint8_t adc_quiet = 0;               // Quiet channels, bit per id
+static uint8_t adc_auto = ADC_NONE;         // Channel started by hardware
+static volatile uint8_t adc_busy = ADC_NONE;        // Channel converting now
+static volatile uint8_t adc_pending = 0;            // Free requests, bit per id
+static volatile uint8_t adc_timed_pending = 0;      // Timed slots that came while busy
+static volatile uint8_t adc_quiet_pending = 0;      // Quiet requests, bit per id
+
+
+// -- Local functions --------------------------------------
+
+/*
+ * Function: adc_start()
+ * Purpose:  Select a channel's input and start its conversion.
+ * Input:    id - channel id
+ * Returns:  none
+ */
+static void adc_start(uint8_t id)
+{
+    adc_busy = id;
+    ADMUX = (ADMUX & 0xF0) | adc_channels[id].mux;
+    ADCSRA |= (1 << ADSC);
+}
+
+
+/*
+ * Function: adc_first()
+ * Purpose:  Lowest id in a request mask.
+ * Input:    mask - requests, bit per id, not 0
+ * Returns:  Channel id
+ */
+static uint8_t adc_first(uint8_t mask)
+{
+    uint8_t id = 0;
+
+    while (!(mask & (1 << id)))
+        id++;
+    return id;
+}
+
+
+/*
+ * Function: adc_next()
+ * Purpose:  Start the next conversion: delayed timed slots first,
+ *           then pending free requests, lowest id first.
+ * Returns:  none
+ */
+static void adc_next(void)
+{
+    uint8_t id;
+
+    if (adc_timed_pending)
+    {
+        id = adc_first(adc_timed_pending);
+        adc_timed_pending &= ~(1 << id);
+        adc_start(id);
+        return;
+    }
+
+    if (adc_pending)
+    {
+        id = adc_first(adc_pending);
+        adc_pending &= ~(1 << id);
+        adc_start(id);
+        return;
+    }
+
+    adc_busy = ADC_NONE;
+    // Keep the auto triggered input selected for the hardware trigger
+    if (adc_auto != ADC_NONE)
+        ADMUX = (ADMUX & 0xF0) | adc_channels[adc_auto].mux;
+}
+
+
+/*
+ * Function: adc_complete()
+ * Purpose:  Store a finished conversion and start the next one.
+ * Input:    value - conversion result
+ * Returns:  none
+ */
+static void adc_complete(uint16_t value)
+{
+    uint8_t id = adc_busy;
+    adc_channel_t *ch;
+
+    if (id == ADC_NONE)
+    {
+        if (adc_auto == ADC_NONE)
+            return;         // Nobody asked for this conversion
+        id = adc_auto;      // Started by the hardware trigger
+    }
+
+    ch = &adc_channels[id];
+    ch->ring[ch->head] = value;
+    ch->stamp = systime_ms();
+    ch->head = (ch->head + 1) & ADC_RING_MASK;
+    if (ch->count < ADC_RING_SIZE)
+        ch->count++;
+
+    if (ch->callback)
+        ch->callback(ch->arg, value);
+
+    adc_next();
+}
+
+
+// -- Function definitions ---------------------------------
+/*
+ * Function: adc_init()
+ * Purpose:  Enable the ADC: AVcc reference, prescaler 64, interrupt on.
+ * Returns:  none
+ */
+void adc_init(void)
+{
+    // Set reference Voltage 5V
+    ADMUX = (1 << REFS0);
+    // Prescaler = 64, fadc= 16MHz/64 = 250kHz
+    ADCSRA = (1 << ADEN) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1);
+}
+
+
+/*
+ * Function: adc_register()
+ * Purpose:  Add an analog input to the request table.
+ * Input:    mux      - ADC input 0..7
+ *           flags    - 0, ADC_TIMED or ADC_QUIET
+ *           callback - called in ISR with arg and every result, or NULL
+ *           arg      - callback context
+ * Returns:  Channel id, -1 when the table is full
+ */
+int8_t adc_register(uint8_t mux, uint8_t flags,
+                    void (*callback)(void *arg, uint16_t value), void *arg)
+{
+    uint8_t id = adc_channel_count;
+
+    if (id >= ADC_MAX_CHANNELS)
+        return -1;
+
+    adc_channels[id].mux = mux & 0x0F;
+    adc_channels[id].callback = callback;
+    adc_channels[id].arg = arg;
+    adc_channel_count++;
+
+    if (flags & ADC_TIMED)
+        adc_timed |= (1 << id);
+    else if (flags & ADC_QUIET)
+        adc_quiet |= (1 << id);
+
+    return id;
+}
+
+
+/*
+ * Function: adc_auto_trigger()
+ * Purpose:  Start the conversions of a timed channel from a hardware
+ *           trigger.
+ * Input:    id     - timed channel id
+ *           source - ADTS2:0 bits of ADCSRB
+ * Returns:  none
+ */
+void adc_auto_trigger(uint8_t id, uint8_t source)
+{
+    if (id >= adc_channel_count || !(adc_timed & (1 << id)))
+        return;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_auto = id;
+        if (adc_busy == ADC_NONE)
+            ADMUX = (ADMUX & 0xF0) | adc_channels[id].mux;
+        ADCSRB = (ADCSRB & ~((1 << ADTS2) | (1 << ADTS1) | (1 << ADTS0))) | source;
+        ADCSRA |= (1 << ADATE);
+    }
+}
+
+
+/*
+ * Function: adc_trigger()
+ * Purpose:  Start a timed conversion, or right after the running one.
+ * Input:    id - timed channel id
+ * Returns:  none
+ */
+void adc_trigger(uint8_t id)
+{
+    if (id >= adc_channel_count || !(adc_timed & (1 << id)))
+        return;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (adc_busy == ADC_NONE)
+            adc_start(id);
+        else
+            adc_timed_pending |= (1 << id);
+    }
+}
+
+
+/*
+ * Function: adc_request()
+ * Purpose:  Ask for one conversion of a channel in a free slot.
+ * Input:    id - channel id
+ * Returns:  none
+ */
+void adc_request(uint8_t id)
+{
+    if (id >= adc_channel_count)
+        return;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (adc_quiet & (1 << id))
+        {
+            adc_quiet_pending |= (1 << id);     // for adc_sleep_convert()
+            return;
+        }
+        adc_pending |= (1 << id);
+        // With timed channels, free slots follow their conversions only
+        if (adc_busy == ADC_NONE && !adc_timed)
+            adc_next();
+    }
+}
+
+
+/*
+ * Function: adc_sleep_convert()
+ * Purpose:  Convert one pending quiet request in ADC Noise Reduction
+ *           sleep mode.
+ * Input:    ready - checked with interrupts off before each sleep
+ * Returns:  1 when a conversion was done, 0 otherwise
+ */
+uint8_t adc_sleep_convert(uint8_t (*ready)(void))
+{
+    uint8_t id;
+
+    cli();
+    if (!adc_quiet_pending || adc_busy != ADC_NONE || adc_timed_pending || !ready())
+    {
+        sei();
+        return 0;
+    }
+    id = adc_first(adc_quiet_pending);
+    adc_quiet_pending &= ~(1 << id);
+
+    // Start it here, entering the sleep mode would start one anyway;
+    // sample-and-hold is 1.5 ADC clocks (96 CPU cycles) away, the CPU
+    // sleeps by then
+    adc_start(id);
+    set_sleep_mode(SLEEP_MODE_ADC);
+    while (adc_busy == id)
+    {
+        if (!ready())
+            break;          // finish with the CPU running
+        sleep_enable();
+        sei();              // SLEEP runs before any pending interrupt
+        sleep_cpu();
+        sleep_disable();
+        cli();
+    }
+    sei();
+    return 1;
+}
+
+
+/*
+ * Function: adc_sleep_pending()
+ * Purpose:  Check for quiet requests waiting for adc_sleep_convert().
+ * Returns:  1 when one is pending
+ */
+uint8_t adc_sleep_pending(void)
+{
+    return adc_quiet_pending != 0;
+}
+
+
+/*
+ * Function: adc_read()
+ * Purpose:  Take the oldest unread sample of a channel.
+ * Input:    id    - channel id
+ *           value - where to store the sample
+ * Returns:  1 when a sample was taken, 0 when the ring is empty
+ */
+uint8_t adc_read(uint8_t id, uint16_t *value)
+{
+    uint8_t ok = 0;
+
+    if (id >= adc_channel_count)
+        return 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_channel_t *ch = &adc_channels[id];
+
+        if (ch->count)
+        {
+            *value = ch->ring[(ch->head - ch->count) & ADC_RING_MASK];
+            ch->count--;
+            ok = 1;
+        }
+    }
+    return ok;
+}
+
+
+/*
+ * Function: adc_last()
+ * Purpose:  Latest sample of a channel, read or not.
+ * Input:    id - channel id
+ * Returns:  Last conversion result
+ */
+uint16_t adc_last(uint8_t id)
+{
+    uint16_t value;
+
+    if (id >= adc_channel_count)
+        return 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_channel_t *ch = &adc_channels[id];
+
+        value = ch->ring[(ch->head - 1) & ADC_RING_MASK];
+    }
+    return value;
+}
+
+
+/*
+ * Function: adc_last_stamped()
+ * Purpose:  Latest sample of a channel and the time it was converted.
+ * Input:    id    - channel id
+ *           stamp - destination of the time, ms
+ * Returns:  Last conversion result
+ */
+uint16_t adc_last_stamped(uint8_t id, uint32_t *stamp)
+{
+    uint16_t value;
+
+    *stamp = 0;
+    if (id >= adc_channel_count)
+        return 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_channel_t *ch = &adc_channels[id];
+
+        value = ch->ring[(ch->head - 1) & ADC_RING_MASK];
+        *stamp = ch->stamp;
+    }
+    return value;
+}
+
+
+/*
+ * Function: adc_isqrt()
+ * Purpose:  Integer square root, rounded down.
+ * Input:    x - radicand
+ * Returns:  floor(sqrt(x))
+ */
+static uint16_t adc_isqrt(uint32_t x)
+{
+    uint32_t root = 0, bit = 1UL << 30;
+
+    while (bit > x)
+        bit >>= 2;
+    while (bit)
+    {
+        if (x >= root + bit)
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+            root >>= 1;
+        bit >>= 2;
+    }
+    return root;
+}
+
+
+/*
+ * Function: adc_noise()
+ * Purpose:  Mean, standard deviation and peak-to-peak of conversions.
+ * Input:    v   - samples
+ *           n   - number of samples, 1..ADC_NOISE_MAX
+ *           out - result
+ * Returns:  none
+ */
+void adc_noise(const uint16_t *v, uint8_t n, adc_noise_t *out)
+{
+    uint16_t lo = 0xFFFF, hi = 0, mean;
+    uint32_t sum = 0, s2 = 0;
+    int32_t d, s1 = 0;
+    uint8_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        sum += v[i];
+        if (v[i] < lo) lo = v[i];
+        if (v[i] > hi) hi = v[i];
+    }
+
+    // variance = (s2 - s1^2 / n) / n around the rounded mean, |s1| <= n / 2
+    mean = (sum + n / 2) / n;
+    for (i = 0; i < n; i++)
+    {
+        d = (int32_t)v[i] - mean;
+        s1 += d;
+        s2 += d * d;
+    }
+
+    out->mean = sum * 100 / n;
+    out->sd = adc_isqrt((s2 * 100 - (uint32_t)(s1 * s1 * 100 / n)) / n);
+    out->pp = hi - lo;
+}
+
+
+/*
+ * Function: Interrupt service routine ADC_vect
+ * Purpose:  Conversion complete, store it and start the next one.
+ */
+ISR(ADC_vect)
+{
+    adc_complete(ADC);
+}
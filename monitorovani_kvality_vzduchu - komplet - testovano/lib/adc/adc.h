@@ -0,0 +1,216 @@
+#ifndef ADC_H
+#define ADC_H
+/*
+ * ADC channel service for AVR-GCC.
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno (ATmega328P, 16 MHz).
+ *
+ * Shares the single ADC between several analog sensors, so that no
+ * driver writes ADMUX or starts conversions on its own.
+ */
+
+/**
+ * @file
+ * @defgroup adc ADC Service <adc.h>
+ * @code #include <adc.h> @endcode
+ *
+ * @brief Interrupt-driven ADC with a per-channel request table.
+ *
+ * Every sensor registers its input once with adc_register() and gets
+ * a channel id. Conversions complete in ISR(ADC_vect), which lives in
+ * this library only; new sensors never touch an ISR.
+ *
+ * Two kinds of slots are arbitrated:
+ *  - timed slots: channels registered with ::ADC_TIMED are converted
+ *    exactly when adc_trigger() is called from a timer ISR, or when the
+ *    hardware auto trigger set by adc_auto_trigger() fires (e.g. the
+ *    GP2Y1010 sample 280 µs into its LED pulse),
+ *  - free slots: adc_request() marks a channel pending. Pending
+ *    channels are converted one after another, lowest id first, right
+ *    after a timed conversion, so they never delay the next timed
+ *    one. Without timed channels they start at once,
+ *  - quiet slots: requests of channels registered with ::ADC_QUIET
+ *    wait for adc_sleep_convert(), which converts them with the CPU in
+ *    ADC Noise Reduction sleep. clkI/O stops while asleep: timers,
+ *    TWI and UART pause for one conversion, so the caller decides when
+ *    that is harmless. Timed channels cannot use it, the conversion is
+ *    started from an ISR.
+ *
+ * Each result is stored in the channel's ring of ::ADC_RING_SIZE
+ * samples (the oldest is overwritten) and passed to the optional
+ * channel callback, which runs in interrupt context. The time of the
+ * latest result, systime_ms() when it completed, is kept with it.
+ *
+ * @code
+ *   int8_t mq = adc_register(0, 0, NULL, NULL);
+ *   adc_request(mq);              // some time later: adc_last(mq)
+ * @endcode
+ * @{
+ */
+
+#include <stdint.h>
+
+
+// -----------------------------------------------------------------------------
+//  Configuration
+// -----------------------------------------------------------------------------
+
+#ifndef ADC_MAX_CHANNELS
+#define ADC_MAX_CHANNELS 4  /**< Registered channels (at most 8) */
+#endif
+
+#ifndef ADC_RING_SIZE
+#define ADC_RING_SIZE 4     /**< Samples kept per channel, power of two */
+#endif
+
+#define ADC_TIMED 0x01      /**< Channel flag: converted in the timed slot */
+#define ADC_QUIET 0x02      /**< Channel flag: converted in ADC Noise Reduction sleep */
+
+/** @brief Conversion time at the 250 kHz ADC clock (13 cycles), in µs. */
+#define ADC_CONVERSION_US 52
+
+/** @brief Samples adc_noise() takes at most, so its sums fit 32 bits. */
+#define ADC_NOISE_MAX 32
+
+
+// -----------------------------------------------------------------------------
+//  Types
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Spread of a series of conversions, from adc_noise().
+ */
+typedef struct {
+    uint32_t mean;              /**< Mean, 0.01 counts */
+    uint16_t sd;                /**< Standard deviation, 0.1 counts */
+    uint16_t pp;                /**< Peak-to-peak, counts */
+} adc_noise_t;
+
+
+// -----------------------------------------------------------------------------
+//  Function prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Enable the ADC: AVcc reference, 250 kHz clock, interrupt on.
+ */
+void adc_init(void);
+
+
+/**
+ * @brief Add an analog input to the request table.
+ *
+ * @param mux       ADC input (0–7).
+ * @param flags     0, ::ADC_TIMED or ::ADC_QUIET.
+ * @param callback  Called from ISR(ADC_vect) with @p arg and every
+ *                  result, or NULL.
+ * @param arg       Passed to @p callback (e.g. the sensor instance).
+ * @return Channel id, or -1 if the table is full.
+ */
+int8_t adc_register(uint8_t mux, uint8_t flags,
+                    void (*callback)(void *arg, uint16_t value), void *arg);
+
+
+/**
+ * @brief Let a hardware trigger start the conversions of a timed channel.
+ *
+ * Keeps its input selected between other conversions and enables auto
+ * triggering from @p source. Only one channel can be auto triggered.
+ *
+ * @param id      Timed channel id.
+ * @param source  ADTS2:0 bits for ADCSRB (e.g. Timer1 compare B).
+ */
+void adc_auto_trigger(uint8_t id, uint8_t source);
+
+
+/**
+ * @brief Start a timed conversion now.
+ *
+ * Call from the timer ISR at the sampling point. If another conversion
+ * is still running this one starts as soon as it completes.
+ *
+ * @param id  Timed channel id.
+ */
+void adc_trigger(uint8_t id);
+
+
+/**
+ * @brief Ask for one conversion of a channel in a free slot.
+ *
+ * @param id  Channel id from adc_register().
+ */
+void adc_request(uint8_t id);
+
+
+/**
+ * @brief Convert one pending quiet request in ADC Noise Reduction sleep.
+ *
+ * Call from the main loop only. The CPU sleeps until ISR(ADC_vect); if
+ * another interrupt wakes it first, it goes back to sleep while
+ * @p ready still agrees.
+ *
+ * @param ready  Checked with interrupts off right before each sleep;
+ *               return 0 while a TWI or UART transfer, or anything else
+ *               that needs clkI/O, is running.
+ * @return 1 if a conversion was done, 0 if none was pending or
+ *         @p ready refused.
+ */
+uint8_t adc_sleep_convert(uint8_t (*ready)(void));
+
+
+/**
+ * @brief Check for quiet requests waiting for adc_sleep_convert().
+ *
+ * @return 1 if at least one is pending.
+ */
+uint8_t adc_sleep_pending(void);
+
+
+/**
+ * @brief Take the oldest unread sample of a channel.
+ *
+ * @param id     Channel id.
+ * @param value  Where to store the sample.
+ * @return 1 if a sample was taken, 0 if the ring is empty.
+ */
+uint8_t adc_read(uint8_t id, uint16_t *value);
+
+
+/**
+ * @brief Latest sample of a channel, whether read or not.
+ *
+ * @param id  Channel id.
+ * @return Last conversion result (0 before the first one).
+ */
+uint16_t adc_last(uint8_t id);
+
+
+/**
+ * @brief Latest sample of a channel with its acquisition time.
+ *
+ * Both are copied together, so the time always belongs to the value.
+ *
+ * @param id     Channel id.
+ * @param stamp  Where to store systime_ms() of the conversion.
+ * @return Last conversion result (0 and stamp 0 before the first one).
+ */
+uint16_t adc_last_stamped(uint8_t id, uint32_t *stamp);
+
+
+/**
+ * @brief Mean, standard deviation and peak-to-peak of conversions.
+ *
+ * Integer only: deviations from the rounded mean keep the sums in
+ * 32 bits for up to ::ADC_NOISE_MAX samples of 10 bits.
+ *
+ * @param v    Samples (0–1023).
+ * @param n    Number of samples, 1 to ::ADC_NOISE_MAX.
+ * @param out  Result.
+ */
+void adc_noise(const uint16_t *v, uint8_t n, adc_noise_t *out);
+
+
+/** @} */
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * DHT12 temperature and humidity sensor library for AVR-GCC.
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno board and ATmega328P, 16 MHz.
+ */
+
+// -- Includes ---------------------------------------------
+#include <dht12.h>
+#include <twi.h>
+#include <systime.h>
+#include <util/atomic.h>
+
+
+// -- Defines ----------------------------------------------
+#define DHT12_HUM_MEM   0       // First register: humidity integer
+#define DHT12_TEMP_MAX  80      // Datasheet range -20..60 C, with margin
+#define DHT12_HUM_MAX   100
+#define DHT12_BACKOFF_S 2       // First retry delay, doubled each time
+
+
+// -- Local data -------------------------------------------
+static volatile uint8_t dht12_frame[DHT12_FRAME_LEN];  // Written by the TWI engine
+static twi_xfer_t dht12_xfer;
+
+static dht12_sample_t dht12_cache;      // Last valid sample
+static uint8_t dht12_valid = 0;         // Cache holds a sample
+static dht12_stats_t dht12_stats;
+
+static uint8_t dht12_retries = 0;       // Retries left for this reading
+static uint8_t dht12_backoff = 0;       // Delay before the next retry, s
+static uint8_t dht12_wait = 0;          // Seconds until the retry, 0 = none
+
+
+// -- Local functions --------------------------------------
+static void dht12_done(twi_xfer_t *xfer);
+
+/*
+ * Function: dht12_submit()
+ * Purpose:  Queue the 5-byte read. Interrupts must be off.
+ * Returns:  none
+ */
+static void dht12_submit(void)
+{
+    dht12_xfer = (twi_xfer_t){
+        .addr = DHT12_ADR,
+        .prio = TWI_PRIO_HIGH,
+        .flags = TWI_XFER_MEMADDR,
+        .memaddr = DHT12_HUM_MEM,
+        .rbuf = dht12_frame,
+        .rlen = DHT12_FRAME_LEN,
+        .callback = dht12_done,
+    };
+
+    if (twi_submit(&dht12_xfer))
+    {
+        dht12_xfer.status = TWI_XFER_ERROR;     // Queue full
+        dht12_done(&dht12_xfer);
+    }
+}
+
+
+/*
+ * Function: dht12_fail()
+ * Purpose:  Count a failed read and schedule the next retry.
+ * Input:    err - DHT12_ERR_* code
+ * Returns:  none
+ */
+static void dht12_fail(uint8_t err)
+{
+    if (err == DHT12_ERR_BUS)
+        dht12_stats.bus_errors++;
+    else if (err == DHT12_ERR_SUM)
+        dht12_stats.sum_errors++;
+    else
+        dht12_stats.range_errors++;
+    dht12_stats.last = err;
+
+    if (dht12_retries)
+    {
+        dht12_retries--;
+        dht12_wait = dht12_backoff;
+        dht12_backoff <<= 1;
+    }
+}
+
+
+/*
+ * Function: dht12_done()
+ * Purpose:  TWI callback: check the frame and update the cache.
+ * Input:    xfer - finished transaction
+ * Returns:  none
+ */
+static void dht12_done(twi_xfer_t *xfer)
+{
+    uint8_t frame[DHT12_FRAME_LEN];
+    dht12_sample_t sample;
+    uint8_t i, err;
+
+    if (xfer->status != TWI_XFER_DONE)
+    {
+        dht12_fail(DHT12_ERR_BUS);
+        return;
+    }
+
+    for (i = 0; i < DHT12_FRAME_LEN; i++)
+        frame[i] = dht12_frame[i];
+
+    err = dht12_decode(frame, &sample);
+    if (err != DHT12_OK)
+    {
+        dht12_fail(err);
+        return;
+    }
+
+    sample.time = systime_ms();
+    dht12_cache = sample;
+    dht12_valid = 1;
+    dht12_stats.reads++;
+    dht12_stats.last = DHT12_OK;
+    dht12_retries = 0;
+}
+
+
+// -- Function definitions ---------------------------------
+/*
+ * Function: dht12_decode()
+ * Purpose:  Check the checksum and ranges of a frame, decode it.
+ * Input:    frame - bytes 0..4 from the sensor
+ *           out   - decoded sample, only written on success
+ * Returns:  DHT12_OK, DHT12_ERR_SUM or DHT12_ERR_RANGE
+ */
+uint8_t dht12_decode(const uint8_t *frame, dht12_sample_t *out)
+{
+    uint8_t sum = frame[0] + frame[1] + frame[2] + frame[3];
+    int16_t temp;
+
+    if (sum != frame[4])
+        return DHT12_ERR_SUM;
+
+    // Decimal bytes hold one digit; the sign is bit 7 of the temperature's.
+    // All zeros passes the checksum but means the sensor has not measured;
+    // 0.0 %RH alone at a real temperature is a valid reading
+    if (frame[1] > 9 || (frame[3] & 0x7f) > 9 ||
+        frame[0] > DHT12_HUM_MAX || frame[2] > DHT12_TEMP_MAX ||
+        (frame[0] | frame[1] | frame[2] | frame[3] | frame[4]) == 0)
+        return DHT12_ERR_RANGE;
+
+    temp = frame[2] * 10 + (frame[3] & 0x7f);
+    out->temp = (frame[3] & 0x80) ? -temp : temp;
+    out->hum = frame[0] * 10 + frame[1];
+    out->age = 0;
+    out->time = 0;
+    return DHT12_OK;
+}
+
+
+/*
+ * Function: dht12_start()
+ * Purpose:  Queue a new reading unless one is running or retrying.
+ * Returns:  none
+ */
+void dht12_start(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (dht12_xfer.status == TWI_XFER_PENDING || dht12_wait)
+            return;
+
+        dht12_retries = DHT12_RETRIES;
+        dht12_backoff = DHT12_BACKOFF_S;
+        dht12_submit();
+    }
+}
+
+
+/*
+ * Function: dht12_tick()
+ * Purpose:  Age the cache and start a due retry, once per second.
+ * Returns:  none
+ */
+void dht12_tick(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (dht12_valid && dht12_cache.age != 0xFFFF)
+            dht12_cache.age++;
+
+        if (dht12_wait && --dht12_wait == 0)
+            dht12_submit();
+    }
+}
+
+
+/*
+ * Function: dht12_get()
+ * Purpose:  Copy the last valid sample.
+ * Input:    out - destination
+ * Returns:  1 when copied, 0 before the first valid reading
+ */
+uint8_t dht12_get(dht12_sample_t *out)
+{
+    uint8_t ok;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ok = dht12_valid;
+        if (ok)
+            *out = dht12_cache;
+    }
+    return ok;
+}
+
+
+/*
+ * Function: dht12_get_stats()
+ * Purpose:  Copy the read counters.
+ * Input:    stats - destination
+ * Returns:  none
+ */
+void dht12_get_stats(dht12_stats_t *stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        *stats = dht12_stats;
+    }
+}
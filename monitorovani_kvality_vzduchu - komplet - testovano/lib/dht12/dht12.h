@@ -0,0 +1,147 @@
+#ifndef DHT12_H
+#define DHT12_H
+/*
+ * DHT12 temperature and humidity sensor library for AVR-GCC.
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno (ATmega328P, 16 MHz).
+ *
+ * Reads the sensor over I2C in the background and keeps the last
+ * valid sample for the rest of the firmware.
+ */
+
+/**
+ * @file
+ * @defgroup dht12 DHT12 Library <dht12.h>
+ * @code #include <dht12.h> @endcode
+ *
+ * @brief Checked, fixed-point DHT12 readings with a last-good cache.
+ *
+ * dht12_start() queues a 5-byte read of registers 0–4 on the TWI
+ * transaction queue; the frame is checked in the TWI interrupt when it
+ * arrives:
+ *  - byte 4 must equal the low byte of the sum of bytes 0–3,
+ *  - the decimal bytes must be 0–9 and the values in range,
+ *  - an all-zero frame (sensor not measured yet) is refused.
+ *
+ * Only a frame that passes replaces the cached sample, so readers of
+ * dht12_get() never see a torn or corrupt value, only an older one. A
+ * failed read is repeated from dht12_tick() after 2, 4, 8 s
+ * (::DHT12_RETRIES attempts), then left to the next dht12_start().
+ *
+ * Temperature is in 0.1 °C, negative below zero (bit 7 of byte 3 is the
+ * sign); humidity is in 0.1 %RH. Each sample carries systime_ms() of
+ * the moment its frame arrived.
+ *
+ * @code
+ *   dht12_start();                // every few seconds
+ *   dht12_tick();                 // every second
+ *   ...
+ *   dht12_sample_t th;
+ *   if (dht12_get(&th))
+ *       p = fmt_fixed(msg, th.temp, 1, 0);
+ * @endcode
+ * @{
+ */
+
+#include <stdint.h>
+
+
+// -----------------------------------------------------------------------------
+//  Configuration
+// -----------------------------------------------------------------------------
+
+#ifndef DHT12_ADR
+#define DHT12_ADR 0x5c          /**< I2C address of the DHT12 */
+#endif
+
+#ifndef DHT12_RETRIES
+#define DHT12_RETRIES 3         /**< Repeated reads after a failure */
+#endif
+
+#define DHT12_FRAME_LEN 5       /**< Humidity, temperature, checksum */
+
+/** @name Result of the last read */
+#define DHT12_OK        0       /**< Frame accepted */
+#define DHT12_PENDING   1       /**< Read queued or waiting for a retry */
+#define DHT12_ERR_BUS   2       /**< No ACK or bus error */
+#define DHT12_ERR_SUM   3       /**< Checksum mismatch */
+#define DHT12_ERR_RANGE 4       /**< Digits or values out of range */
+
+
+// -----------------------------------------------------------------------------
+//  Types
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief One decoded reading.
+ */
+typedef struct {
+    int16_t temp;               /**< Temperature, 0.1 °C */
+    uint16_t hum;               /**< Relative humidity, 0.1 % */
+    uint16_t age;               /**< Seconds since it was read (dht12_tick()) */
+    uint32_t time;              /**< systime_ms() when the frame arrived */
+} dht12_sample_t;
+
+/**
+ * @brief Read counters.
+ */
+typedef struct {
+    uint16_t reads;             /**< Frames accepted */
+    uint16_t bus_errors;        /**< Transactions that failed */
+    uint16_t sum_errors;        /**< Frames with a bad checksum */
+    uint16_t range_errors;      /**< Frames with impossible values */
+    uint8_t last;               /**< DHT12_OK or DHT12_ERR_* of the last read */
+} dht12_stats_t;
+
+
+// -----------------------------------------------------------------------------
+//  Function prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Check and decode a raw frame.
+ *
+ * @param frame  Bytes 0–4 as read from the sensor.
+ * @param out    Decoded sample (age and time 0), written only on success.
+ * @return ::DHT12_OK, ::DHT12_ERR_SUM or ::DHT12_ERR_RANGE.
+ */
+uint8_t dht12_decode(const uint8_t *frame, dht12_sample_t *out);
+
+
+/**
+ * @brief Queue a new reading unless one is already in progress.
+ *
+ * Does not block; safe to call from a timer interrupt.
+ */
+void dht12_start(void);
+
+
+/**
+ * @brief Age the cached sample and run due retries.
+ *
+ * Call once per second, also from a timer interrupt.
+ */
+void dht12_tick(void);
+
+
+/**
+ * @brief Copy the last valid sample.
+ *
+ * @param out  Where to store the sample.
+ * @return 1 if a sample was copied, 0 if none was read yet.
+ */
+uint8_t dht12_get(dht12_sample_t *out);
+
+
+/**
+ * @brief Copy the read counters.
+ *
+ * @param stats  Where to store them.
+ */
+void dht12_get_stats(dht12_stats_t *stats);
+
+
+/** @} */
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * Number formatting library for AVR-GCC.
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno board and ATmega328P, 16 MHz.
+ */
+
+// -- Includes ---------------------------------------------
+#include <fmt.h>
+#include <avr/pgmspace.h>
+
+
+// -- Local data -------------------------------------------
+
+/* Powers of ten for digit extraction by subtraction */
+static const uint32_t fmt_pow10[] PROGMEM = {
+    1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+    10000UL, 1000UL, 100UL, 10UL, 1UL
+};
+
+
+// -- Local functions --------------------------------------
+
+/*
+ * Function: fmt_digits()
+ * Purpose:  Convert a number to decimal digits, most significant first.
+ * Input:    digits - buffer for at least 10 characters
+ *           value  - number to convert
+ * Returns:  Number of digits (at least 1)
+ */
+static uint8_t fmt_digits(char *digits, uint32_t value)
+{
+    uint8_t n = 0;
+
+    for (uint8_t i = 0; i < sizeof(fmt_pow10)/sizeof(fmt_pow10[0]); i++)
+    {
+        uint32_t p = pgm_read_dword(&fmt_pow10[i]);
+        char d = '0';
+
+        while (value >= p)
+        {
+            value -= p;
+            d++;
+        }
+        if (d != '0' || n != 0 || p == 1)   // Skip leading zeros
+            digits[n++] = d;
+    }
+    return n;
+}
+
+
+/*
+ * Function: fmt_number()
+ * Purpose:  Common formatter for integers and fixed-point numbers.
+ * Input:    buf      - destination buffer
+ *           mag      - absolute value
+ *           neg      - 1 to print a minus sign
+ *           decimals - digits after the decimal point
+ *           width    - minimum field width
+ *           pad      - fill character, ' ' or '0'
+ * Returns:  Pointer to the terminating '\0'
+ */
+static char *fmt_number(char *buf, uint32_t mag, uint8_t neg, uint8_t decimals,
+                        uint8_t width, char pad)
+{
+    char digits[10];
+    uint8_t n = fmt_digits(digits, mag);
+    uint8_t zeros = (n <= decimals) ? decimals + 1 - n : 0;  // e.g. 0.05
+    uint8_t len = neg + zeros + n + (decimals != 0);
+    uint8_t fill = (width > len) ? width - len : 0;
+
+    if (pad != '0')
+        while (fill--)
+            *buf++ = pad;
+    if (neg)
+        *buf++ = '-';
+    if (pad == '0')
+        while (fill--)
+            *buf++ = '0';
+
+    /* Leading zeros and digits, with the decimal point before the last
+       'decimals' of them */
+    for (uint8_t left = zeros + n; left > 0; left--)
+    {
+        if (left == decimals)
+            *buf++ = '.';
+        *buf++ = (left > n) ? '0' : digits[n - left];
+    }
+
+    *buf = '\0';
+    return buf;
+}
+
+
+// -- Functions --------------------------------------------
+
+/*
+ * Function: fmt_uint()
+ * Purpose:  Print an unsigned integer, right-aligned in a field.
+ * Returns:  Pointer to the terminating '\0'
+ */
+char *fmt_uint(char *buf, uint32_t value, uint8_t width, char pad)
+{
+    return fmt_number(buf, value, 0, 0, width, pad);
+}
+
+
+/*
+ * Function: fmt_int()
+ * Purpose:  Print a signed integer, right-aligned in a field.
+ * Returns:  Pointer to the terminating '\0'
+ */
+char *fmt_int(char *buf, int32_t value, uint8_t width, char pad)
+{
+    if (value < 0)
+        return fmt_number(buf, -(uint32_t)value, 1, 0, width, pad);
+    return fmt_number(buf, value, 0, 0, width, pad);
+}
+
+
+/*
+ * Function: fmt_fixed()
+ * Purpose:  Print value / 10^decimals with a decimal point.
+ * Returns:  Pointer to the terminating '\0'
+ */
+char *fmt_fixed(char *buf, int32_t value, uint8_t decimals, uint8_t width)
+{
+    if (value < 0)
+        return fmt_number(buf, -(uint32_t)value, 1, decimals, width, ' ');
+    return fmt_number(buf, value, 0, decimals, width, ' ');
+}
+
+
+/*
+ * Function: fmt_str()
+ * Purpose:  Copy a string and return the end for further appending.
+ * Returns:  Pointer to the terminating '\0'
+ */
+char *fmt_str(char *buf, const char *s)
+{
+    while ((*buf = *s++) != '\0')
+        buf++;
+    return buf;
+}
@@ -0,0 +1,88 @@
+#ifndef FMT_H
+#define FMT_H
+/*
+ * Number formatting library for AVR-GCC.
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno (ATmega328P, 16 MHz).
+ *
+ * Small replacement for the sprintf() conversions used on the display
+ * and UART paths, without pulling in avr-libc's vfprintf.
+ */
+
+/**
+ * @file
+ * @defgroup fmt Formatting Library <fmt.h>
+ * @code #include <fmt.h> @endcode
+ *
+ * @brief Right-aligned integer and fixed-point formatting.
+ *
+ * All functions write into a caller-supplied buffer, terminate it with
+ * '\0' and return a pointer to that terminator, so calls can be chained
+ * to build a line piece by piece:
+ * @code
+ *   char *p = fmt_str(msg, "Temp: ");
+ *   p = fmt_fixed(p, -53, 1, 0);      // "-5.3"
+ *   fmt_str(p, " C\r\n");
+ * @endcode
+ * Digits are produced by subtracting powers of ten, so no division
+ * routine is needed. Nothing is allocated; the caller must provide room
+ * for the result (at most 12 characters + terminator, or @c width).
+ * @{
+ */
+
+#include <stdint.h>
+
+
+// -----------------------------------------------------------------------------
+//  Function prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Format an unsigned integer (like "%*u" / "%0*u").
+ *
+ * @param buf    Destination buffer.
+ * @param value  Number to print.
+ * @param width  Minimum field width, 0 for none.
+ * @param pad    Fill character for the field, ' ' or '0'.
+ * @return Pointer to the terminating '\0'.
+ */
+char *fmt_uint(char *buf, uint32_t value, uint8_t width, char pad);
+
+
+/**
+ * @brief Format a signed integer (like "%*d" / "%0*d").
+ *
+ * @param buf    Destination buffer.
+ * @param value  Number to print.
+ * @param width  Minimum field width including the sign, 0 for none.
+ * @param pad    Fill character for the field, ' ' or '0'.
+ * @return Pointer to the terminating '\0'.
+ */
+char *fmt_int(char *buf, int32_t value, uint8_t width, char pad);
+
+
+/**
+ * @brief Format a fixed-point number.
+ *
+ * @param buf       Destination buffer.
+ * @param value     Number scaled by 10^decimals (e.g. 253 and 1 → "25.3").
+ * @param decimals  Digits after the decimal point (0 prints an integer).
+ * @param width     Minimum field width, right-aligned with spaces.
+ * @return Pointer to the terminating '\0'.
+ */
+char *fmt_fixed(char *buf, int32_t value, uint8_t decimals, uint8_t width);
+
+
+/**
+ * @brief Copy a string.
+ *
+ * @param buf  Destination buffer.
+ * @param s    String to append.
+ * @return Pointer to the terminating '\0'.
+ */
+char *fmt_str(char *buf, const char *s);
+
+/** @} */
+
+#endif
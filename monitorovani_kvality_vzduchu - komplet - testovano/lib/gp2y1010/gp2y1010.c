@@ -1,77 +1,406 @@
 
 #include "gp2y1010.h"
 #include "timer.h"             // Timer0 macros
+#include <adc.h>
+#include <systime.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <stddef.h>
 
-volatile uint16_t last_raw = 0;
+// Registered sensors, in the order of gp2y1010_init()
+static GP2Y1010 *sensors[GP2Y1010_MAX_SENSORS];
+static uint8_t sensor_count = 0;
 
-// State machine timing
-// Timer0 overflow period: 16 µs
+// Filter window
+#if GP2Y1010_TRIM
+#define GP2Y1010_WINDOW ((1 << GP2Y1010_WINDOW_BITS) + 2)
+#else
+#define GP2Y1010_WINDOW (1 << GP2Y1010_WINDOW_BITS)
+#endif
+
+// Fixed-point conversion, Q4 full scale 1023 × 16 ↔ 5000 mV
+// Multipliers are Q16 and rounded, folded from the calibration:
+// mV per count, 0.1 µg/m3 per count (10 / slope), clean-air level in counts
+#define GP2Y1010_Q4_FS       16368UL
+#define GP2Y1010_MV_Q16      ((5000ULL * 65536 * 2 / GP2Y1010_Q4_FS + 1) / 2)
+#define GP2Y1010_DENSITY_Q16 ((65536ULL * 5000 * 1000 * 10 * 2 / \
+                              (GP2Y1010_Q4_FS * GP2Y1010_SLOPE_UV) + 1) / 2)
+#define GP2Y1010_V0_Q4       ((GP2Y1010_V0_MV * GP2Y1010_Q4_FS + 2500) / 5000)
+
+#if GP2Y1010_AUTO_BASELINE
+// EEPROM record per sensor, checked by magic and CRC before use
+#define GP2Y1010_BASE_MAGIC 0x6230
+typedef struct {
+    uint16_t magic;
+    uint16_t base;      // Q4
+    uint16_t crc;
+} gp2y1010_base_t;
+
+static gp2y1010_base_t EEMEM ee_base[GP2Y1010_MAX_SENSORS];
+
+static uint16_t base_crc(const gp2y1010_base_t *rec) {
+    const uint8_t *b = (const uint8_t *)rec;
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < offsetof(gp2y1010_base_t, crc); i++)
+        crc = _crc_ccitt_update(crc, b[i]);
+    return crc;
+}
+
+// New filtered window (interrupt context)
+static void base_update(GP2Y1010 *s, uint16_t q4) {
+    uint32_t x = (uint32_t)q4 << 16;
+
+    if (s->base == 0) {
+        s->base = x;                        // first window without EEPROM data
+    } else if (x < s->base) {
+        s->base -= (s->base - x) >> 2;      // cleaner air, follow quickly
+    } else {
+        s->base += GP2Y1010_BASE_RISE_Q16;  // slow rise, never above the value
+        if (s->base > x) s->base = x;
+    }
+    if (s->base_windows < 0xFFFF) s->base_windows++;
+}
+#endif
+
+#ifdef GP2Y1010_HW_PULSE
+// Hardware timing, Timer1 fast PWM (mode 14, TOP = ICR1), prescaler 8:
+// 1 tick = 0.5 µs
+// Period 10 ms → ICR1 = 19999
+// OC1A active from BOTTOM to OCR1A (LED ON), 0.32 ms → OCR1A = 639
+// Compare B starts the ADC; sample-and-hold closes 2 ADC clocks (8 µs)
+// after an auto trigger, so 280 - 8 = 272 µs → OCR1B = 543
+#define GP2Y1010_PERIOD    19999
+#define GP2Y1010_PULSE     639
+#define GP2Y1010_TRIGGER   543
+#else
+// Event timing, per sensor
+// Timer0 prescaler 256: 1 tick = 16 µs, frame 10 ms → 625 ticks
 // GP2Y1010 timing (datasheet):
-// LED ON 280 µs → 18 ticks
-// Extra 40 µs → 2 ticks
-// LED OFF 9.7 ms → 605 ticks
-volatile uint8_t state = 0;
-volatile uint16_t ticks = 0;
+// LED ON at tick 0
+// ADC started at tick 17, sample-and-hold 1.5 ADC clocks (6 µs)
+// later → 278 µs ≈ 280 µs
+// LED OFF at tick 20 → 320 µs pulse
+// Compare match A fires at the next event, or GP2Y1010_MAX_WAIT ticks
+// ahead so the software time below never misses an 8-bit wrap
+#define GP2Y1010_FRAME     625
+#define GP2Y1010_SAMPLE    17
+#define GP2Y1010_PULSE     20
+#define GP2Y1010_MAX_WAIT  200
+
+// Events of a sensor (GP2Y1010::step)
+#define STEP_LED_ON  0
+#define STEP_SAMPLE  1
+#define STEP_LED_OFF 2
+
+// Timer0 ticks, extended to 16 bits; updated at least every
+// GP2Y1010_MAX_WAIT ticks by the compare ISR
+static uint16_t t0_time;
+
+static uint16_t t0_now(void) {
+    t0_time += (uint8_t)(TCNT0 - (uint8_t)t0_time);
+    return t0_time;
+}
+
+static void led_on(uint8_t pin) {
+#if GP2Y1010_LED_ACTIVE_LOW
+    PORTD &= ~(1 << pin);
+#else
+    PORTD |= (1 << pin);
+#endif
+}
+
+static void led_off(uint8_t pin) {
+#if GP2Y1010_LED_ACTIVE_LOW
+    PORTD |= (1 << pin);
+#else
+    PORTD &= ~(1 << pin);
+#endif
+}
+#endif
+
+#if GP2Y1010_MEDIAN3
+static uint16_t median3(uint16_t a, uint16_t b, uint16_t c) {
+    if (a > b) { uint16_t t = a; a = b; b = t; }
+    // a <= b now
+    if (c <= a) return a;
+    if (c >= b) return b;
+    return c;
+}
+#endif
+
+// Called by the ADC service with every dust sample (interrupt context)
+static void gp2y1010_sample(void *arg, uint16_t raw) {
+    GP2Y1010 *s = arg;
+
+#ifdef GP2Y1010_HW_PULSE
+    TIFR1 = (1 << OCF1B);   // re-arm the auto trigger
+#endif
+
+#if GP2Y1010_MEDIAN3
+    if (!s->med_primed) {
+        s->med[0] = s->med[1] = raw;
+        s->med_primed = 1;
+    }
+    uint16_t m = median3(s->med[0], s->med[1], raw);
+    s->med[0] = s->med[1];
+    s->med[1] = raw;
+    raw = m;
+#endif
+
+    s->win_sum += raw;
+#if GP2Y1010_TRIM
+    if (raw < s->win_min) s->win_min = raw;
+    if (raw > s->win_max) s->win_max = raw;
+#endif
+    if (++s->win_count < GP2Y1010_WINDOW) return;
+
+#if GP2Y1010_TRIM
+    s->win_sum -= (uint32_t)s->win_min + s->win_max;
+    s->win_min = 0xFFFF;
+    s->win_max = 0;
+#endif
+    // 2^WINDOW_BITS samples left, scale the sum to counts × 16
+#if GP2Y1010_WINDOW_BITS >= 4
+    s->filtered = s->win_sum >> (GP2Y1010_WINDOW_BITS - 4);
+#else
+    s->filtered = s->win_sum << (4 - GP2Y1010_WINDOW_BITS);
+#endif
+    s->filtered_ms = systime_ms();
+#if GP2Y1010_AUTO_BASELINE
+    base_update(s, s->filtered);
+#endif
+    s->win_sum = 0;
+    s->win_count = 0;
+}
 
 void gp2y1010_init(GP2Y1010 *s) {
-    // Configure LED pin as output
+    s->adc = -1;
+    if (sensor_count >= GP2Y1010_MAX_SENSORS) return;
+
+    // Dust output is converted in a timed slot of the ADC service
+    s->adc = adc_register(s->analogPin, ADC_TIMED, gp2y1010_sample, s);
+    if (s->adc < 0) return;
+    s->slot = sensor_count;
+
+    s->win_sum = 0;
+    s->win_count = 0;
+#if GP2Y1010_TRIM
+    s->win_min = 0xFFFF;
+    s->win_max = 0;
+#endif
+#if GP2Y1010_MEDIAN3
+    s->med_primed = 0;
+#endif
+    s->filtered = 0;
+    s->filtered_ms = 0;
+
+#if GP2Y1010_AUTO_BASELINE
+    // Start from the baseline of the last run, if there is a valid one
+    gp2y1010_base_t rec;
+    s->base = 0;
+    s->base_windows = 0;
+    s->base_saved = 0;
+    eeprom_read_block(&rec, &ee_base[s->slot], sizeof(rec));
+    if (rec.magic == GP2Y1010_BASE_MAGIC && rec.crc == base_crc(&rec) && rec.base) {
+        s->base = (uint32_t)rec.base << 16;
+        s->base_saved = rec.base;
+    }
+#endif
+
+#ifdef GP2Y1010_HW_PULSE
+    sensors[sensor_count++] = s;
+
+    // LED on OC1A (PB1, Arduino D9), OFF until the timer runs
+#if GP2Y1010_LED_ACTIVE_LOW
+    PORTB |= (1 << PB1);
+#else
+    PORTB &= ~(1 << PB1);
+#endif
+    DDRB |= (1 << PB1);
+
+    // Conversions start on Timer1 compare B
+    adc_auto_trigger(s->adc, (1 << ADTS2) | (1 << ADTS0));
+
+    ICR1 = GP2Y1010_PERIOD;
+    OCR1A = GP2Y1010_PULSE;
+    OCR1B = GP2Y1010_TRIGGER;
+    TCNT1 = 0;
+    // Fast PWM mode 14, OC1A inverted (set on compare match, cleared at
+    // BOTTOM) for an active-low LED, non-inverted otherwise
+#if GP2Y1010_LED_ACTIVE_LOW
+    TCCR1A = (1 << COM1A1) | (1 << COM1A0) | (1 << WGM11);
+#else
+    TCCR1A = (1 << COM1A1) | (1 << WGM11);
+#endif
+    TCCR1B = (1 << WGM13) | (1 << WGM12) | (1 << CS11);
+#else
+    // Configure LED pin as output, LED OFF
+    led_off(s->ledPin);
     DDRD |= (1 << s->ledPin);
-    // Set reference Voltage 5V
-    ADMUX = (1 << REFS0);
-    // Prescaler = 64, fadc= 16MHz/64 = 250kHz
-    ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1);
 
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        sensors[sensor_count++] = s;
+        if (sensor_count == 1) t0_time = TCNT0;
+
+        // Spread the pulses evenly over the frame, sensor 0 starts next;
+        // a pulse cut short by the move is skipped for one frame
+        uint16_t ref = t0_now() + 2;
+        for (uint8_t i = 0; i < sensor_count; i++) {
+            GP2Y1010 *t = sensors[i];
+
+            if (t != s && t->step != STEP_LED_ON) led_off(t->ledPin);
+            t->step = STEP_LED_ON;
+            t->next = ref + (uint16_t)i * GP2Y1010_FRAME / sensor_count;
+        }
+        OCR0A = (uint8_t)ref;
+    }
+
+    if (sensor_count == 1) {
+        // Timer0 runs the events: normal mode, 16 µs per tick
+        tim0_compa_16us();
+        tim0_compa_enable();
+    }
+#endif
 }
 
-// Timer0 Overflow Interrupt Service Routine
-ISR(TIMER0_OVF_vect) {
-    ticks++;
+#ifndef GP2Y1010_HW_PULSE
+// Timer0 Compare Match A Interrupt Service Routine: run the due
+// events, then arm the compare for the next one
+ISR(TIMER0_COMPA_vect) {
+    uint16_t now, wait;
 
-    switch (state) {
+    do {
+        now = t0_now();
+        wait = GP2Y1010_MAX_WAIT;
 
-    case 0: // LED ON for 280 µs
-        PORTD |= ~(1 << PD2);
-        
+        for (uint8_t i = 0; i < sensor_count; i++) {
+            GP2Y1010 *s = sensors[i];
 
-        if (ticks >= 18) {
-            ticks = 0;
-            state = 1;
+            while ((int16_t)(now - s->next) >= 0) {
+                switch (s->step) {
+                case STEP_LED_ON:   // LED ON for 320 µs
+                    led_on(s->ledPin);
+                    s->next += GP2Y1010_SAMPLE;
+                    s->step = STEP_SAMPLE;
+                    break;
+                case STEP_SAMPLE:   // sample, result comes through gp2y1010_sample()
+                    adc_trigger(s->adc);
+                    s->next += GP2Y1010_PULSE - GP2Y1010_SAMPLE;
+                    s->step = STEP_LED_OFF;
+                    break;
+                default:            // LED OFF ~9.7 ms
+                    led_off(s->ledPin);
+                    s->next += GP2Y1010_FRAME - GP2Y1010_PULSE;
+                    s->step = STEP_LED_ON;
+                    break;
+                }
+            }
+            if ((uint16_t)(s->next - now) < wait) wait = s->next - now;
         }
-        break;
 
-    case 1: // LED still ON for 40 µs, sample ADC
-        if (ticks == 1) {
-            // Select ADC channel 1
-            ADMUX = (ADMUX & 0xF0) | 1;
+        OCR0A = (uint8_t)(now + wait);
+        // Passed already while the events ran: run them now
+    } while ((uint8_t)(OCR0A - TCNT0) == 0 || (uint8_t)(OCR0A - TCNT0) > wait);
+}
+#endif
 
-            // Start ADC conversion
-            ADCSRA |= (1 << ADSC);
-            while (ADCSRA & (1 << ADSC));
+uint16_t gp2y1010_read_raw(GP2Y1010 *s) {
+    if (s->adc < 0) return 0;
+    return adc_last(s->adc);
+}
 
-            last_raw = ADC;
-        }
+uint16_t gp2y1010_read_filtered(GP2Y1010 *s) {
+    uint16_t value;
 
-        if (ticks >= 2) {
-            PORTD &= (1 << PD2); // Turn LED OFF
-            ticks = 0;
-            state = 2;
-        }
-        break;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        value = s->filtered;
+    }
+    return value;
+}
+
+uint16_t gp2y1010_read_stamped(GP2Y1010 *s, uint32_t *ms) {
+    uint16_t value;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        value = s->filtered;
+        *ms = s->filtered_ms;
+    }
+    return value;
+}
 
-    case 2: // LED OFF ~9.7 ms
-        if (ticks >= 605) {
-            ticks = 0;
-            state = 0;
+uint8_t gp2y1010_quiet(void) {
+#ifdef GP2Y1010_HW_PULSE
+    // Margin of 128 µs on both sides of the pulse
+    uint16_t t = TCNT1;
+    return t > GP2Y1010_PULSE + 256 && t < GP2Y1010_PERIOD - 256;
+#else
+    // Margin of 8 ticks (128 µs) before the next pulse
+    uint8_t quiet = 1;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        uint16_t now = t0_now();
+
+        for (uint8_t i = 0; i < sensor_count; i++) {
+            GP2Y1010 *s = sensors[i];
+            if (s->step != STEP_LED_ON || (uint16_t)(s->next - now) <= 8) quiet = 0;
         }
-        break;
     }
+    return quiet;
+#endif
 }
 
-uint16_t gp2y1010_read_raw(GP2Y1010 *s) {
+uint16_t gp2y1010_q4_to_mv(uint16_t q4) {
+    return ((uint32_t)q4 * GP2Y1010_MV_Q16 + 0x8000) >> 16;
+}
+
+uint16_t gp2y1010_q4_to_density(GP2Y1010 *s, uint16_t q4) {
+    uint16_t v0 = gp2y1010_baseline(s);
+    if (q4 <= v0) return 0;
+    return ((uint32_t)(q4 - v0) * GP2Y1010_DENSITY_Q16 + 0x8000) >> 16;
+}
+
+uint16_t gp2y1010_baseline(GP2Y1010 *s) {
+#if GP2Y1010_AUTO_BASELINE
+    uint32_t b;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        b = s->base;
+    }
+    if (b) return (b + 0x8000) >> 16;
+#else
     (void)s; // unused
-    return last_raw;
+#endif
+    return GP2Y1010_V0_Q4;
+}
+
+void gp2y1010_baseline_save(void) {
+#if GP2Y1010_AUTO_BASELINE
+    for (uint8_t i = 0; i < sensor_count; i++) {
+        GP2Y1010 *s = sensors[i];
+        gp2y1010_base_t rec;
+        uint16_t windows;
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            windows = s->base_windows;
+        }
+        if (windows < GP2Y1010_BASE_SAVE_WINDOWS) continue;
+
+        rec.base = gp2y1010_baseline(s);
+        if (rec.base + GP2Y1010_BASE_SAVE_DELTA > s->base_saved &&
+            s->base_saved + GP2Y1010_BASE_SAVE_DELTA > rec.base) continue;   // no real change
+
+        rec.magic = GP2Y1010_BASE_MAGIC;
+        rec.crc = base_crc(&rec);
+        eeprom_update_block(&rec, &ee_base[s->slot], sizeof(rec));
+        s->base_saved = rec.base;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            s->base_windows = 0;
+        }
+    }
+#endif
 }
 
 float gp2y1010_adc_to_voltage(uint16_t raw) {
@@ -79,9 +408,9 @@ float gp2y1010_adc_to_voltage(uint16_t raw) {
 }
 
 float gp2y1010_voltage_to_density(float v) {
-    float v0 = 0.1f;  // change value based on calibration
+    float v0 = GP2Y1010_V0_MV / 1000.0f;
     if (v < v0) return 0.0f;
-    return (v - v0) / 0.005f;   // 0.005V ~ 1 ug/m3
+    return (v - v0) / (GP2Y1010_SLOPE_UV / 1e6f);   // 0.005V ~ 1 ug/m3
 }
 
 
@@ -3,15 +3,139 @@
 
 #include <stdint.h>
 
-// Structure describing the sensor pins
+// Sensors driven from the one Timer0 state machine. Their 0.32 ms
+// pulses are spread evenly over the 10 ms frame (sensor i starts i/N
+// of a frame after sensor 0), each keeps the datasheet timing. The ADC
+// service needs a channel per sensor plus the other analog inputs.
+#ifndef GP2Y1010_MAX_SENSORS
+#define GP2Y1010_MAX_SENSORS 1
+#endif
+
+// LED input of the bare sensor is on when pulled low; set 0 for
+// modules with a driver transistor (LED on when the pin is high)
+#ifndef GP2Y1010_LED_ACTIVE_LOW
+#define GP2Y1010_LED_ACTIVE_LOW 1
+#endif
+
+// Drive the LED and start the ADC from Timer1 in hardware:
+// LED on OC1A (PB1, Arduino D9) instead of ledPin, 0.32 ms on every
+// 10 ms, ADC auto-triggered by compare B at the 280 µs sampling point.
+// Timer1 is taken by the sensor in this mode, one sensor only.
+//
+// Interrupts per second (Timer0 rate checked in test_gp2y1010, ISR cost
+// estimated from its length, not measured):
+//   Timer0 events:     ~600 TIMER0_COMPA per sensor + 100 ADC, < 1 % CPU
+//   GP2Y1010_HW_PULSE: 100 ADC, < 0.1 % CPU
+// Interrupt latency: the Timer0 ISR no longer waits ~52 µs for the
+// conversion every 10 ms (UART interrupts were held off meanwhile),
+// ADC_vect takes the result. The latency before and after was not
+// measured: no cycle-accurate simulator (simavr) is set up for this
+// project, so only the removed busy wait is known.
+// Other ADC channels are converted right after each dust sample.
+//#define GP2Y1010_HW_PULSE
+
+// Filter pipeline, run in constant time on every 10 ms sample:
+//   median-of-3 → window sum → drop window min and max → scale to Q4
+// The window holds 2^GP2Y1010_WINDOW_BITS samples (+2 when trimming);
+// averaging 4^k samples gains up to k effective bits over the 10-bit ADC.
+// RAM: 17 bytes per sensor, whatever the window.
+#ifndef GP2Y1010_WINDOW_BITS
+#define GP2Y1010_WINDOW_BITS 6   // 64 samples, one result every 0.66 s
+#endif
+#ifndef GP2Y1010_MEDIAN3
+#define GP2Y1010_MEDIAN3 1       // median of 3 successive samples
+#endif
+#ifndef GP2Y1010_TRIM
+#define GP2Y1010_TRIM 1          // trimmed mean, window min/max discarded
+#endif
+
+#if GP2Y1010_WINDOW_BITS > 10
+#error "GP2Y1010_WINDOW_BITS: 10 at most, the window sum must fit 32 bits"
+#endif
+#if defined(GP2Y1010_HW_PULSE) && GP2Y1010_MAX_SENSORS > 1
+#error "GP2Y1010_HW_PULSE drives a single sensor from OC1A"
+#endif
+
+// Calibration (datasheet typical values)
+#ifndef GP2Y1010_V0_MV
+#define GP2Y1010_V0_MV 100        // output in clean air, mV
+#endif
+#ifndef GP2Y1010_SLOPE_UV
+#define GP2Y1010_SLOPE_UV 5000    // sensitivity, µV per µg/m3
+#endif
+
+// Clean-air baseline tracking, replaces GP2Y1010_V0_MV when enabled.
+// Leaky minimum of the filtered output: follows lower values within a few
+// windows, rises by GP2Y1010_BASE_RISE_Q16 / 65536 Q4 units per window
+// (default ~1 Q4 unit = 1/16 count = 0.3 mV per 10 min), so it settles
+// on the cleanest air seen over the last hours. Saved to EEPROM at most
+// once per GP2Y1010_BASE_SAVE_WINDOWS (~1 h) and only after a real
+// change: under 9000 writes a year, EEPROM is good for 100,000.
+#ifndef GP2Y1010_AUTO_BASELINE
+#define GP2Y1010_AUTO_BASELINE 1
+#endif
+#ifndef GP2Y1010_BASE_RISE_Q16
+#define GP2Y1010_BASE_RISE_Q16 73
+#endif
+#ifndef GP2Y1010_BASE_SAVE_WINDOWS
+#define GP2Y1010_BASE_SAVE_WINDOWS 5400
+#endif
+#ifndef GP2Y1010_BASE_SAVE_DELTA
+#define GP2Y1010_BASE_SAVE_DELTA 4     // Q4 counts
+#endif
+
+// Structure describing the sensor pins, followed by the driver state
+// (leave it zero, gp2y1010_init() sets it up)
 typedef struct {
-    uint8_t ledPin;      // LED control pin (digital output)
+    uint8_t ledPin;      // LED control pin, PORTD bit (digital output)
     uint8_t analogPin;   // ADC channel number (0–7)
+
+    int8_t adc;          // channel id in the ADC service, -1 if none
+    uint8_t slot;        // registration order, EEPROM record index
+    uint16_t next;       // time of the next LED/ADC event, Timer0 ticks
+    uint8_t step;        // which event that is
+
+    uint32_t win_sum;    // filter window
+    uint16_t win_count;
+#if GP2Y1010_TRIM
+    uint16_t win_min;
+    uint16_t win_max;
+#endif
+#if GP2Y1010_MEDIAN3
+    uint16_t med[2];     // two previous samples
+    uint8_t med_primed;
+#endif
+    uint16_t filtered;   // last window, Q4
+    uint32_t filtered_ms; // systime_ms() at the end of that window
+
+#if GP2Y1010_AUTO_BASELINE
+    uint32_t base;          // Q4 × 65536, 0 = nothing measured yet
+    uint16_t base_windows;  // windows since the last EEPROM write
+    uint16_t base_saved;    // baseline in EEPROM, Q4
+#endif
 } GP2Y1010;
 
 // Public function prototypes
+// Call adc_init() first, each sensor takes a timed slot of the ADC service;
+// sensors beyond GP2Y1010_MAX_SENSORS are left with adc = -1
 void gp2y1010_init(GP2Y1010 *s);
 uint16_t gp2y1010_read_raw(GP2Y1010 *s);
+// Last filtered window in Q4: ADC counts × 16 (0..16368), 0 before the first
+uint16_t gp2y1010_read_filtered(GP2Y1010 *s);
+// Same, with the time its window ended (systime_ms()) stored in *ms
+uint16_t gp2y1010_read_stamped(GP2Y1010 *s, uint32_t *ms);
+// 1 when no LED pulse is on or about to start: timers may stop for one
+// ADC conversion (adc_sleep_convert()) without stretching a pulse
+uint8_t gp2y1010_quiet(void);
+// Fixed-point conversions of a Q4 value (counts × 16), no float code:
+// output voltage in mV, density in 0.1 µg/m3 (error < 1 unit)
+uint16_t gp2y1010_q4_to_mv(uint16_t q4);
+uint16_t gp2y1010_q4_to_density(GP2Y1010 *s, uint16_t q4);
+// Clean-air output in use (Q4), tracked or GP2Y1010_V0_MV
+uint16_t gp2y1010_baseline(GP2Y1010 *s);
+// Store the tracked baselines in EEPROM when due; call from the main loop,
+// a write blocks for a few ms
+void gp2y1010_baseline_save(void);
 float gp2y1010_adc_to_voltage(uint16_t raw);
 float gp2y1010_voltage_to_density(float voltage);
 
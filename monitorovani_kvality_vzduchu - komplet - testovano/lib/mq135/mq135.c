@@ -0,0 +1,391 @@
+/*
+ * MQ135 gas sensor library for AVR-GCC.
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno board and ATmega328P, 16 MHz.
+ */
+
+// -- Includes ---------------------------------------------
+#include <mq135.h>
+#include <stddef.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+
+// -- Local data -------------------------------------------
+
+/*
+ * Rs/Rs(20 °C, 33 %RH) at 33 %RH, Q12, from -10 °C to 50 °C in 10 °C
+ * steps: 0.00035 t^2 - 0.02718 t + 1.39538 fitted to the datasheet curve
+ */
+#define MQ135_T_MIN  (-100)     // 0.1 °C
+#define MQ135_T_STEP 100        // 0.1 °C
+static const uint16_t mq135_temp_q12[] PROGMEM = {
+    6972, 5715, 4746, 4062, 3666, 3556, 3733
+};
+#define MQ135_T_POINTS (sizeof(mq135_temp_q12) / sizeof(mq135_temp_q12[0]))
+
+/* Humidity term: -0.0018 per %RH above 33 %, per 0.1 % in Q12 × 1024 */
+#define MQ135_RH_REF   330      // 0.1 %
+#define MQ135_RH_Q22   755
+
+/*
+ * CO2 curve, ppm = 116.602 * (Rs/R0)^-2.769, on a geometric grid of
+ * Rs/R0 (factor 1.1 between points), ratio in Q12
+ */
+typedef struct {
+    uint16_t ratio;
+    uint16_t ppm;
+} mq135_point_t;
+
+static const mq135_point_t mq135_curve[] PROGMEM = {
+    {  819, 10057}, {  901,  7722}, {  991,  5932}, { 1090,  4557},
+    { 1199,  3500}, { 1319,  2688}, { 1451,  2064}, { 1596,  1585},
+    { 1756,  1217}, { 1932,   934}, { 2125,   718}, { 2337,   551},
+    { 2571,   423}, { 2828,   325}, { 3111,   250}, { 3422,   192},
+    { 3764,   147}, { 4141,   113}, { 4555,    87}, { 5010,    67},
+    { 5511,    51}, { 6062,    39}, { 6669,    30}, { 7335,    23},
+    { 8069,    18}, { 8876,    14}, { 9763,    11}, {10740,     8},
+    {11814,     6}
+};
+#define MQ135_POINTS (sizeof(mq135_curve) / sizeof(mq135_curve[0]))
+
+static uint32_t mq135_r0 = MQ135_R0_OHM;
+static uint32_t mq135_time = 0;     // Calibration timestamp
+
+/* EEPROM record, checked by magic and CRC before use */
+#define MQ135_CAL_MAGIC 0x5230
+typedef struct {
+    uint16_t magic;
+    uint32_t r0;        // ohm
+    uint32_t time;      // Timestamp given at calibration
+    uint16_t crc;
+} mq135_cal_t;
+
+static mq135_cal_t EEMEM ee_cal;
+
+/* Warm-up detection */
+static uint16_t warm_avg = 0;       // Running average of counts, Q4
+static uint16_t warm_ref = 0;       // Average at the start of the window
+static uint16_t warm_seconds = 0;   // Since mq135_init()
+static uint8_t warm_tick = 0;       // Seconds into the slope window
+static uint8_t warm_flat = 0;       // Settled windows in a row
+static volatile uint8_t warm_ready = 0;
+
+
+// -- Local functions --------------------------------------
+
+/*
+ * Function: mq135_cal_crc()
+ * Purpose:  CRC-CCITT of an EEPROM record without its crc field.
+ * Input:    rec - record
+ * Returns:  CRC
+ */
+static uint16_t mq135_cal_crc(const mq135_cal_t *rec)
+{
+    const uint8_t *b = (const uint8_t *)rec;
+    uint16_t crc = 0xFFFF;
+    uint8_t i;
+
+    for (i = 0; i < offsetof(mq135_cal_t, crc); i++)
+        crc = _crc_ccitt_update(crc, b[i]);
+    return crc;
+}
+
+
+/*
+ * Function: mq135_ratio()
+ * Purpose:  Rs/R0 for a concentration, inverse of the curve table.
+ * Input:    ppm - concentration
+ * Returns:  Ratio in Q12 (400 ppm: 2631; the curve itself gives 2624,
+ *           this inverse of the table makes mq135_ppm() return 400)
+ */
+static uint16_t mq135_ratio(uint16_t ppm)
+{
+    uint16_t r_lo, r_hi, p_lo, p_hi;
+    uint8_t i;
+
+    if (ppm >= pgm_read_word(&mq135_curve[0].ppm))
+        return pgm_read_word(&mq135_curve[0].ratio);
+
+    for (i = 1; i < MQ135_POINTS - 1; i++)
+    {
+        if (ppm > pgm_read_word(&mq135_curve[i].ppm))
+            break;
+    }
+    r_lo = pgm_read_word(&mq135_curve[i - 1].ratio);
+    r_hi = pgm_read_word(&mq135_curve[i].ratio);
+    p_lo = pgm_read_word(&mq135_curve[i - 1].ppm);
+    p_hi = pgm_read_word(&mq135_curve[i].ppm);
+    if (ppm <= p_hi)
+        return r_hi;
+
+    return r_lo + ((uint32_t)(r_hi - r_lo) * (p_lo - ppm)) / (p_lo - p_hi);
+}
+
+
+// -- Function definitions ---------------------------------
+/*
+ * Function: mq135_init()
+ * Purpose:  Restore R0 from EEPROM, restart warm-up detection.
+ * Returns:  1 when a valid calibration was loaded
+ */
+uint8_t mq135_init(void)
+{
+    mq135_cal_t rec;
+
+    warm_avg = 0;
+    warm_seconds = 0;
+    warm_tick = 0;
+    warm_flat = 0;
+    warm_ready = 0;
+
+    eeprom_read_block(&rec, &ee_cal, sizeof(rec));
+    if (rec.magic == MQ135_CAL_MAGIC && rec.crc == mq135_cal_crc(&rec) &&
+        rec.r0 != 0 && rec.r0 != 0xFFFFFFFFUL)
+    {
+        mq135_r0 = rec.r0;
+        mq135_time = rec.time;
+        return 1;
+    }
+    mq135_r0 = MQ135_R0_OHM;
+    mq135_time = 0;
+    return 0;
+}
+
+
+/*
+ * Function: mq135_warmup()
+ * Purpose:  Follow the slope of the running average once per second.
+ * Input:    counts - 10-bit ADC value
+ * Returns:  1 once settled
+ */
+uint8_t mq135_warmup(uint16_t counts)
+{
+    uint16_t slope;
+
+    if (warm_ready)
+        return 1;
+
+    // Average over about 8 s, in Q4
+    if (warm_seconds == 0)
+        warm_avg = warm_ref = counts << 4;
+    else
+        warm_avg += ((int16_t)((counts << 4) - warm_avg)) >> 3;
+    warm_seconds++;
+
+    if (++warm_tick >= MQ135_SLOPE_WINDOW_S)
+    {
+        warm_tick = 0;
+        slope = (warm_avg > warm_ref) ? warm_avg - warm_ref : warm_ref - warm_avg;
+        warm_ref = warm_avg;
+
+        if (slope < (MQ135_SLOPE_MAX << 4))
+        {
+            if (warm_flat < MQ135_SLOPE_WINDOWS)
+                warm_flat++;
+        }
+        else
+            warm_flat = 0;
+    }
+
+    if ((warm_flat >= MQ135_SLOPE_WINDOWS && warm_seconds >= MQ135_WARMUP_MIN_S) ||
+        warm_seconds >= MQ135_WARMUP_MAX_S)
+        warm_ready = 1;
+
+    return warm_ready;
+}
+
+
+/*
+ * Function: mq135_ready()
+ * Purpose:  Sensor settled after power-up.
+ * Returns:  1 when readings can be trusted
+ */
+uint8_t mq135_ready(void)
+{
+    return warm_ready;
+}
+
+
+/*
+ * Function: mq135_rs()
+ * Purpose:  Sensor resistance from the divider reading.
+ * Input:    counts - 10-bit ADC value
+ * Returns:  Rs in ohm, MQ135_RS_OPEN for 0 counts
+ */
+uint32_t mq135_rs(uint16_t counts)
+{
+    if (counts == 0)
+        return MQ135_RS_OPEN;
+    if (counts > 1023)
+        counts = 1023;
+
+    return (MQ135_RL_OHM * (1023 - counts)) / counts;
+}
+
+
+/*
+ * Function: mq135_correction()
+ * Purpose:  Temperature/humidity factor, interpolated from the table.
+ * Input:    temp - 0.1 degC
+ *           rh   - 0.1 %
+ * Returns:  Factor in Q12
+ */
+uint16_t mq135_correction(int16_t temp, uint16_t rh)
+{
+    int16_t t = temp - MQ135_T_MIN;
+    uint8_t i;
+    int16_t f0, f1;
+    int32_t factor;
+
+    if (t < 0)
+        t = 0;
+    if (t >= (int16_t)((MQ135_T_POINTS - 1) * MQ135_T_STEP))
+        t = (MQ135_T_POINTS - 1) * MQ135_T_STEP - 1;
+
+    i = t / MQ135_T_STEP;
+    t -= i * MQ135_T_STEP;
+    f0 = pgm_read_word(&mq135_temp_q12[i]);
+    f1 = pgm_read_word(&mq135_temp_q12[i + 1]);
+    factor = f0 + ((int32_t)(f1 - f0) * t) / MQ135_T_STEP;
+
+    // Wetter air lowers Rs
+    factor -= ((int32_t)rh - MQ135_RH_REF) * MQ135_RH_Q22 / 1024;
+    if (factor < 1024)
+        factor = 1024;          // Keep away from the edge of the curve
+
+    return factor;
+}
+
+
+/*
+ * Function: mq135_rs_corrected()
+ * Purpose:  Rs referred to 20 degC and 33 %RH.
+ * Input:    counts - 10-bit ADC value
+ *           temp   - 0.1 degC
+ *           rh     - 0.1 %
+ * Returns:  Compensated Rs in ohm
+ */
+uint32_t mq135_rs_corrected(uint16_t counts, int16_t temp, uint16_t rh)
+{
+    uint32_t rs = mq135_rs(counts);
+    uint16_t factor = mq135_correction(temp, rh);
+
+    if (rs == MQ135_RS_OPEN)
+        return rs;
+    if (rs >= MQ135_RS_OPEN / 4096)
+        return (rs / factor) * 4096;
+    return (rs * 4096) / factor;
+}
+
+
+/*
+ * Function: mq135_ppm()
+ * Purpose:  CO2-equivalent ppm for a compensated Rs, linear
+ *           interpolation in the table.
+ * Input:    rs - compensated Rs in ohm
+ * Returns:  ppm, clamped to the table
+ */
+uint16_t mq135_ppm(uint32_t rs)
+{
+    uint32_t r0 = mq135_r0;
+    uint16_t ratio;
+    uint16_t r_lo, r_hi, p_lo, p_hi;
+    uint8_t i;
+
+    // Rs/R0 in Q12; beyond the last point the answer is clamped anyway
+    if (rs / 3 >= r0)
+        return pgm_read_word(&mq135_curve[MQ135_POINTS - 1].ppm);
+    while (rs > 0xFFFFF)        // rs * 4096 must fit 32 bits
+    {
+        rs >>= 1;
+        r0 >>= 1;
+    }
+    ratio = (rs << 12) / r0;
+
+    if (ratio <= pgm_read_word(&mq135_curve[0].ratio))
+        return pgm_read_word(&mq135_curve[0].ppm);
+
+    for (i = 1; i < MQ135_POINTS - 1; i++)
+    {
+        if (ratio < pgm_read_word(&mq135_curve[i].ratio))
+            break;
+    }
+    r_lo = pgm_read_word(&mq135_curve[i - 1].ratio);
+    r_hi = pgm_read_word(&mq135_curve[i].ratio);
+    p_lo = pgm_read_word(&mq135_curve[i - 1].ppm);
+    p_hi = pgm_read_word(&mq135_curve[i].ppm);
+    if (ratio >= r_hi)
+        return p_hi;
+
+    // ppm falls with the ratio; rounded, truncating would bias it up
+    return p_lo - ((uint32_t)(p_lo - p_hi) * (ratio - r_lo) + (r_hi - r_lo) / 2) /
+                  (r_hi - r_lo);
+}
+
+
+/*
+ * Function: mq135_set_r0()
+ * Purpose:  Set the clean-air resistance.
+ * Input:    r0 - ohm, 0 for the default
+ * Returns:  none
+ */
+void mq135_set_r0(uint32_t r0)
+{
+    mq135_r0 = r0 ? r0 : MQ135_R0_OHM;
+}
+
+
+/*
+ * Function: mq135_get_r0()
+ * Purpose:  Clean-air resistance in use.
+ * Returns:  R0 in ohm
+ */
+uint32_t mq135_get_r0(void)
+{
+    return mq135_r0;
+}
+
+
+/*
+ * Function: mq135_calibrate()
+ * Purpose:  Take R0 from Rs in clean air and store it in EEPROM.
+ * Input:    rs   - compensated Rs in clean air, ohm
+ *           time - timestamp kept with R0
+ * Returns:  New R0 in ohm, 0 for an invalid reading
+ */
+uint32_t mq135_calibrate(uint32_t rs, uint32_t time)
+{
+    mq135_cal_t rec;
+    uint16_t ratio = mq135_ratio(MQ135_CLEAN_PPM);
+
+    if (rs == 0 || rs == MQ135_RS_OPEN)
+        return 0;
+
+    // R0 = Rs / (Rs/R0 at the clean-air concentration)
+    if (rs >= MQ135_RS_OPEN / 4096)
+        rec.r0 = (rs / ratio) * 4096;
+    else
+        rec.r0 = (rs * 4096) / ratio;
+    rec.time = time;
+    rec.magic = MQ135_CAL_MAGIC;
+    rec.crc = mq135_cal_crc(&rec);
+    eeprom_update_block(&rec, &ee_cal, sizeof(rec));
+
+    mq135_r0 = rec.r0;
+    mq135_time = time;
+    return rec.r0;
+}
+
+
+/*
+ * Function: mq135_cal_time()
+ * Purpose:  Timestamp of the calibration in use.
+ * Returns:  Timestamp, 0 when not calibrated
+ */
+uint32_t mq135_cal_time(void)
+{
+    return mq135_time;
+}
@@ -0,0 +1,205 @@
+#ifndef MQ135_H
+#define MQ135_H
+/*
+ * MQ135 gas sensor library for AVR-GCC.
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno (ATmega328P, 16 MHz).
+ *
+ * Converts the ADC reading of the MQ135 divider to sensor resistance
+ * and CO2-equivalent concentration, compensated for temperature and
+ * relative humidity.
+ */
+
+/**
+ * @file
+ * @defgroup mq135 MQ135 Library <mq135.h>
+ * @code #include <mq135.h> @endcode
+ *
+ * @brief Rs, T/RH compensation and ppm estimation in fixed point.
+ *
+ * The sensor resistance Rs sits between 5 V and the ADC input, the load
+ * resistor @ref MQ135_RL_OHM from the input to ground:
+ * @code
+ *   Rs = RL * (1023 - counts) / counts
+ * @endcode
+ * Rs is divided by the datasheet temperature/humidity factor
+ * (Rs/Rs(20 °C, 33 %RH), a PROGMEM table over temperature plus a linear
+ * humidity term) and the ratio Rs/R0 is looked up in a PROGMEM table of
+ * the CO2 curve, ppm = 116.6 * (Rs/R0)^-2.769, with linear interpolation
+ * between points. No pow(), log() or float at run time. Against the
+ * curve the result is within 1.7 % above 100 ppm and 9.5 % above
+ * 10 ppm, where the whole-ppm result dominates (measured by test_mq135
+ * over every Q12 ratio).
+ *
+ * The heater needs minutes to settle. mq135_warmup() is fed one reading
+ * per second and follows a running average of the counts; the sensor is
+ * ready once the average has moved less than ::MQ135_SLOPE_MAX counts per
+ * ::MQ135_SLOPE_WINDOW_S seconds for ::MQ135_SLOPE_WINDOWS windows in a
+ * row (at least ::MQ135_WARMUP_MIN_S, at most ::MQ135_WARMUP_MAX_S after
+ * power-up). Readings before that are not to be trusted.
+ *
+ * mq135_calibrate() takes the compensated Rs in clean air (assumed
+ * ::MQ135_CLEAN_PPM) as the new R0 and stores it with a timestamp and a
+ * CRC in EEPROM; mq135_init() restores it at power-up.
+ *
+ * @code
+ *   mq135_init();
+ *   ...
+ *   mq135_warmup(counts);                 // every second
+ *   if (mq135_ready())
+ *       ppm = mq135_ppm(mq135_rs_corrected(counts, 215, 455));
+ * @endcode
+ * @{
+ */
+
+#include <stdint.h>
+
+
+// -----------------------------------------------------------------------------
+//  Configuration
+// -----------------------------------------------------------------------------
+
+#ifndef MQ135_RL_OHM
+#define MQ135_RL_OHM 10000UL    /**< Load resistor on the module, Ω */
+#endif
+
+#ifndef MQ135_R0_OHM
+#define MQ135_R0_OHM 76630UL    /**< Rs in clean air until calibrated, Ω */
+#endif
+
+#ifndef MQ135_CLEAN_PPM
+#define MQ135_CLEAN_PPM 400     /**< CO2 in clean outdoor air, ppm */
+#endif
+
+#ifndef MQ135_WARMUP_MIN_S
+#define MQ135_WARMUP_MIN_S 120  /**< Never ready sooner, s */
+#endif
+
+#ifndef MQ135_WARMUP_MAX_S
+#define MQ135_WARMUP_MAX_S 1800 /**< Ready anyway after this, s */
+#endif
+
+#ifndef MQ135_SLOPE_WINDOW_S
+#define MQ135_SLOPE_WINDOW_S 30 /**< Slope measured over this, s */
+#endif
+
+#ifndef MQ135_SLOPE_MAX
+#define MQ135_SLOPE_MAX 2       /**< Settled below this, counts per window */
+#endif
+
+#ifndef MQ135_SLOPE_WINDOWS
+#define MQ135_SLOPE_WINDOWS 3   /**< Settled windows needed in a row */
+#endif
+
+#define MQ135_RS_OPEN 0xFFFFFFFFUL  /**< Rs when the reading is 0 counts */
+
+
+// -----------------------------------------------------------------------------
+//  Function prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Restore R0 from EEPROM and restart the warm-up detection.
+ *
+ * @return 1 if a valid calibration was found, 0 if ::MQ135_R0_OHM is used.
+ */
+uint8_t mq135_init(void);
+
+
+/**
+ * @brief Feed the warm-up detection with one reading.
+ *
+ * Call once per second, also from an interrupt.
+ *
+ * @param counts  10-bit ADC value.
+ * @return 1 once the sensor has settled.
+ */
+uint8_t mq135_warmup(uint16_t counts);
+
+
+/**
+ * @brief Sensor settled after power-up.
+ *
+ * @return 1 if readings can be trusted.
+ */
+uint8_t mq135_ready(void);
+
+
+/**
+ * @brief Sensor resistance from an ADC reading.
+ *
+ * @param counts  10-bit ADC value of the divider output.
+ * @return Rs in Ω, ::MQ135_RS_OPEN for 0 counts.
+ */
+uint32_t mq135_rs(uint16_t counts);
+
+
+/**
+ * @brief Temperature and humidity factor Rs/Rs(20 °C, 33 %RH).
+ *
+ * @param temp  Temperature in 0.1 °C, clamped to -10..50 °C.
+ * @param rh    Relative humidity in 0.1 %.
+ * @return Factor in Q12 (4096 = 1.0; the datasheet fit gives 0.992 at
+ *         20 °C, 33 %RH).
+ */
+uint16_t mq135_correction(int16_t temp, uint16_t rh);
+
+
+/**
+ * @brief Sensor resistance referred to 20 °C and 33 %RH.
+ *
+ * @param counts  10-bit ADC value.
+ * @param temp    Temperature in 0.1 °C.
+ * @param rh      Relative humidity in 0.1 %.
+ * @return Compensated Rs in Ω.
+ */
+uint32_t mq135_rs_corrected(uint16_t counts, int16_t temp, uint16_t rh);
+
+
+/**
+ * @brief CO2-equivalent concentration for a compensated Rs.
+ *
+ * @param rs  Compensated sensor resistance in Ω.
+ * @return ppm, clamped to the table range (6..10057).
+ */
+uint16_t mq135_ppm(uint32_t rs);
+
+
+/**
+ * @brief Set the clean-air resistance used by mq135_ppm().
+ *
+ * @param r0  R0 in Ω (0 restores ::MQ135_R0_OHM).
+ */
+void mq135_set_r0(uint32_t r0);
+
+
+/**
+ * @brief Clean-air resistance in use.
+ *
+ * @return R0 in Ω.
+ */
+uint32_t mq135_get_r0(void);
+
+
+/**
+ * @brief Calibrate in clean air and store R0 in EEPROM.
+ *
+ * @param rs    Compensated Rs measured in clean air, Ω.
+ * @param time  Timestamp stored with R0 (e.g. Unix time from the host).
+ * @return New R0 in Ω, 0 if @p rs is not a valid reading.
+ */
+uint32_t mq135_calibrate(uint32_t rs, uint32_t time);
+
+
+/**
+ * @brief Timestamp of the calibration in use.
+ *
+ * @return Value passed to mq135_calibrate(), 0 if not calibrated.
+ */
+uint32_t mq135_cal_time(void);
+
+
+/** @} */
+
+#endif
@@ -10,7 +10,8 @@
 # include <avr/pgmspace.h>
 
 // extern const char ssd1306oled_font[][6] PROGMEM;
-// extern const char special_char[][2] PROGMEM;
+// extern const uint8_t special_char[128] PROGMEM;
+// extern const uint8_t double_nibble[16] PROGMEM;
 
 const char ssd1306oled_font[][6] PROGMEM = {
     {0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // sp
@@ -111,7 +112,7 @@ const char ssd1306oled_font[][6] PROGMEM = {
     /* end of normal char-set */
     /* put your own signs/chars here, edit special_char too */
     /* be sure that your first special char stand here */
-    {0x00, 0x3A, 0x40, 0x40, 0x20, 0x7A}, // ü, !!! Important: this must be special_char[0] !!!
+    {0x00, 0x3A, 0x40, 0x40, 0x20, 0x7A}, // ü, !!! Important: first special char, index 95 !!!
     {0x00, 0x3D, 0x40, 0x40, 0x40, 0x3D}, // Ü
     {0x00, 0x21, 0x54, 0x54, 0x54, 0x79}, // ä
     {0x00, 0x7D, 0x12, 0x11, 0x12, 0x7D}, // Ä
@@ -124,24 +125,28 @@ const char ssd1306oled_font[][6] PROGMEM = {
     {0x00, 0x5C, 0x62, 0x02, 0x62, 0x5C} // Ω
 };
 
-const char special_char[][2] PROGMEM = {
-    // define position of special char in font
-    // {special char, position in font}
-    // be sure that last element of this
-    // array are {0xff, 0xff} and first element
-    // are {first special char, first element after normal char-set in font}
-    {'ü', 95},  // special_char[0]
-    {'Ü', 96},
-    {'ä', 97},
-    {'Ä', 98},
-    {'ö', 99},
-    {'Ö', 100},
-    {'°', 101},
-    {'ß', 102},
-    {'µ', 103},
-    {'ω', 104},
-    {'Ω', 105},
-    {0xff, 0xff} // end of table special_char
+const uint8_t special_char[128] PROGMEM = {
+    // position of special char in font, indexed by (byte value - 0x80)
+    // of the char as stored in the source string, 0 = no glyph;
+    // first element after normal char-set in font is 95
+    // (a lookup instead of a search, so every char costs the same)
+    [(uint8_t)'ü' - 0x80] = 95,
+    [(uint8_t)'Ü' - 0x80] = 96,
+    [(uint8_t)'ä' - 0x80] = 97,
+    [(uint8_t)'Ä' - 0x80] = 98,
+    [(uint8_t)'ö' - 0x80] = 99,
+    [(uint8_t)'Ö' - 0x80] = 100,
+    [(uint8_t)'°' - 0x80] = 101,
+    [(uint8_t)'ß' - 0x80] = 102,
+    [(uint8_t)'µ' - 0x80] = 103,
+    [(uint8_t)'ω' - 0x80] = 104,
+    [(uint8_t)'Ω' - 0x80] = 105
+};
+
+const uint8_t double_nibble[16] PROGMEM = {
+    // every bit of a nibble doubled, for DOUBLESIZE chars
+    0x00, 0x03, 0x0C, 0x0F, 0x30, 0x33, 0x3C, 0x3F,
+    0xC0, 0xC3, 0xCC, 0xCF, 0xF0, 0xF3, 0xFC, 0xFF
 };
 //
 #endif
\ No newline at end of file
@@ -61,6 +61,85 @@ static uint8_t charMode = NORMALSIZE;
 #if defined GRAPHICMODE
 # include <stdlib.h>
 static uint8_t displayBuffer[DISPLAY_HEIGHT/8][DISPLAY_WIDTH];
+// columns changed since the last flush: [dirtyFrom, dirtyTo) per page
+static uint8_t dirtyFrom[DISPLAY_HEIGHT/8];
+static uint8_t dirtyTo[DISPLAY_HEIGHT/8];
+static void oled_mark_dirty(uint8_t line, uint8_t x, uint8_t width) {
+    if (line > (DISPLAY_HEIGHT/8-1) || x > DISPLAY_WIDTH-1) return;  // out of Display
+    uint8_t end = (width > DISPLAY_WIDTH-x) ? DISPLAY_WIDTH : x + width;
+    if (dirtyTo[line] <= dirtyFrom[line]) {
+        dirtyFrom[line] = x;
+        dirtyTo[line] = end;
+    } else {
+        if (x < dirtyFrom[line]) dirtyFrom[line] = x;
+        if (end > dirtyTo[line]) dirtyTo[line] = end;
+    }
+}
+static void oled_mark_clean(void) {
+    memset(dirtyFrom, 0x00, sizeof(dirtyFrom));
+    memset(dirtyTo, 0x00, sizeof(dirtyTo));
+}
+# if OLED_SHADOW != OLED_SHADOW_NONE
+// what the display RAM holds, in blocks of 16 columns
+#  define SHADOW_BLOCK  16
+#  define SHADOW_BLOCKS (DISPLAY_WIDTH/SHADOW_BLOCK)
+#  if SHADOW_BLOCKS > 8
+#   error "shadowStale holds 8 blocks per page"
+#  endif
+static uint8_t shadowStale[DISPLAY_HEIGHT/8];  // bit per block: display RAM content unknown
+#  if OLED_SHADOW == OLED_SHADOW_FULL
+#   if RAMEND < 0x8FF + DISPLAY_WIDTH*DISPLAY_HEIGHT/8
+#    warning "OLED_SHADOW_FULL needs another 1 KB of SRAM, use OLED_SHADOW_CHECKSUM"
+#   endif
+static uint8_t shadow[DISPLAY_HEIGHT/8][DISPLAY_WIDTH];
+#  elif OLED_SHADOW == OLED_SHADOW_CHECKSUM
+#   include <util/crc16.h>
+static uint16_t shadow[DISPLAY_HEIGHT/8][SHADOW_BLOCKS];
+#  else
+#   error "No valid OLED_SHADOW mode! Refer oled.h"
+#  endif
+#  if OLED_SHADOW == OLED_SHADOW_CHECKSUM
+static uint16_t oled_block_crc(uint8_t line, uint8_t block) {
+    const uint8_t *src = &displayBuffer[line][block*SHADOW_BLOCK];
+    uint16_t crc = 0xffff;
+    for (uint8_t i = 0; i < SHADOW_BLOCK; i++) {
+        crc = _crc_ccitt_update(crc, src[i]);
+    }
+    return crc;
+}
+#  endif
+// returns 1 if the display RAM holds something else than the block
+static uint8_t oled_shadow_changed(uint8_t line, uint8_t block) {
+    if (shadowStale[line] & (1 << block)) return 1;
+#  if OLED_SHADOW == OLED_SHADOW_FULL
+    return memcmp(shadow[line] + block*SHADOW_BLOCK,
+                  displayBuffer[line] + block*SHADOW_BLOCK, SHADOW_BLOCK) != 0;
+#  else
+    return shadow[line][block] != oled_block_crc(line, block);
+#  endif
+}
+// columns [x, x+width) of a page have reached the display RAM
+static void oled_shadow_sync(uint8_t x, uint8_t line, uint8_t width) {
+    for (uint8_t b = x/SHADOW_BLOCK; b*SHADOW_BLOCK < x+width; b++) {
+        if (b*SHADOW_BLOCK >= x && (b+1)*SHADOW_BLOCK <= x+width) {
+#  if OLED_SHADOW == OLED_SHADOW_FULL
+            memcpy(shadow[line] + b*SHADOW_BLOCK, displayBuffer[line] + b*SHADOW_BLOCK, SHADOW_BLOCK);
+#  else
+            shadow[line][b] = oled_block_crc(line, b);
+#  endif
+            shadowStale[line] &= ~(1 << b);
+        } else {
+            shadowStale[line] |= (1 << b);  // partly sent, content unknown
+        }
+    }
+}
+// sending columns [x, x+width) of a page failed, content unknown
+static void oled_shadow_lost(uint8_t x, uint8_t line, uint8_t width) {
+    for (uint8_t b = x/SHADOW_BLOCK; b*SHADOW_BLOCK < x+width; b++) {
+        shadowStale[line] |= (1 << b);
+    }
+}
+# endif
 #elif defined TEXTMODE
 #else
 # error "No valid displaymode! Refer oled.h"
@@ -98,18 +177,51 @@ const uint8_t init_sequence [] PROGMEM = {    // Initialization Sequence
     0x8D, 0x14,      // Set DC-DC enable
 };
 // #pragma mark LCD COMMUNICATION
+#if defined I2C
+// display traffic is queued behind sensor reads sharing the bus
+static uint8_t oled_twi_write(uint8_t control, const uint8_t buf[], uint16_t size) {
+    twi_xfer_t xfer = {
+        .addr = OLED_I2C_ADR,
+        .prio = TWI_PRIO_LOW,
+        .flags = TWI_XFER_MEMADDR,
+        .memaddr = control,    // 0x00 for command, 0x40 for data
+        .wbuf = buf,
+        .wlen = size,
+    };
+    return twi_transfer(&xfer);
+}
+#if defined SH1106 && defined GRAPHICMODE
+// set page and column and send the data in a single transfer: every
+// command byte is preceded by a control byte with Co=1 (0x80), the
+// data stream by the control byte 0x40
+#define PAGE_PREFIX_SIZE 11
+static void oled_page_prefix(uint8_t prefix[PAGE_PREFIX_SIZE], uint8_t x, uint8_t line) {
+    prefix[0] = 0x80; prefix[1] = 0xb0+line;
+    prefix[2] = 0x80; prefix[3] = 0x21;
+    prefix[4] = 0x80; prefix[5] = 0x00+((2+x) & (0x0f));
+    prefix[6] = 0x80; prefix[7] = 0x10+( ((2+x) & (0xf0)) >> 4 );
+    prefix[8] = 0x80; prefix[9] = 0x7f;
+    prefix[10] = 0x40;
+}
+static uint8_t oled_page_write(uint8_t x, uint8_t line, const uint8_t data[], uint8_t width) {
+    uint8_t prefix[PAGE_PREFIX_SIZE];
+    oled_page_prefix(prefix, x, line);
+    twi_iov_t payload = { data, width };
+    twi_xfer_t xfer = {
+        .addr = OLED_I2C_ADR,
+        .prio = TWI_PRIO_LOW,
+        .wbuf = prefix,
+        .wlen = sizeof(prefix),
+        .wiov = &payload,
+        .wiovcnt = 1,
+    };
+    return twi_transfer(&xfer);
+}
+#endif
+#endif
 void oled_command(uint8_t cmd[], uint8_t size) {
 #if defined I2C
-    twi_start();
-    twi_write((OLED_I2C_ADR<<1) | TWI_WRITE);
-    // i2c_start((OLED_I2C_ADR << 1) | 0);
-    twi_write(0x00);
-    // i2c_byte(0x00);    // 0x00 for command, 0x40 for data
-    for (uint8_t i=0; i<size; i++) {
-        twi_write(cmd[i]);
-        // i2c_byte(cmd[i]);
-    }
-    twi_stop();
+    oled_twi_write(0x00, cmd, size);
 #elif defined SPI
 	OLED_PORT &= ~(1 << CS_PIN);
 	OLED_PORT &= ~(1 << DC_PIN);
@@ -122,17 +234,7 @@ void oled_command(uint8_t cmd[], uint8_t size) {
 }
 void oled_data(uint8_t data[], uint16_t size) {
 #if defined I2C
-    twi_start();
-    twi_write((OLED_I2C_ADR<<1) | TWI_WRITE);
-    // i2c_start((OLED_I2C_ADR << 1) | 0);
-    twi_write(0x40);
-    // i2c_byte(0x40);    // 0x00 for command, 0x40 for data
-    for (uint16_t i = 0; i<size; i++) {
-        twi_write(data[i]);
-        // i2c_byte(data[i]);
-    }
-    twi_stop();
-    // i2c_stop();
+    oled_twi_write(0x40, data, size);
 #elif defined SPI
 	OLED_PORT &= ~(1 << CS_PIN);
 	OLED_PORT |= (1 << DC_PIN);
@@ -149,6 +251,7 @@ void oled_init(uint8_t dispAttr){
 #if defined I2C
     // i2c_init();
     twi_init();
+    twi_set_device_speed(OLED_I2C_ADR, OLED_I2C_SPEED);
 #elif defined SPI
 	DDRB |= (1 << PB2)|(1 << PB3)|(1 << PB5);
     SPCR = (1 << SPE)|(1<<MSTR)|(1<<SPR0);
@@ -189,6 +292,10 @@ void oled_clrscr(void){
         oled_gotoxy(0,i);
         oled_data(displayBuffer[i], sizeof(displayBuffer[i]));
     }
+    oled_mark_clean();
+# if OLED_SHADOW != OLED_SHADOW_NONE
+    memset(shadowStale, 0xff, sizeof(shadowStale));
+# endif
 #elif defined TEXTMODE
     uint8_t displayBuffer[DISPLAY_WIDTH];
     memset(displayBuffer, 0x00, sizeof(displayBuffer));
@@ -224,7 +331,15 @@ void oled_set_contrast(uint8_t contrast){
     uint8_t commandSequence[2] = {0x81, contrast};
     oled_command(commandSequence, sizeof(commandSequence));
 }
+static uint8_t oled_glyph(char c){
+    // font index of a printable char, 0xff if font has no glyph for it
+    uint8_t glyph = (uint8_t)c;
+    if (glyph < 0x80) return (glyph < ' ' || glyph > '~') ? 0xff : glyph - ' ';
+    glyph = pgm_read_byte(&special_char[glyph - 0x80]);
+    return glyph ? glyph : 0xff;
+}
 void oled_putc(char c){
+    uint8_t glyph;
     switch (c) {
         case '\b':
             // backspace
@@ -252,36 +367,22 @@ void oled_putc(char c){
             break;
         default:
             // char doesn't fit in line
-            if( (cursorPosition.x >= DISPLAY_WIDTH-sizeof(FONT[0])) || (c < ' ') ) break;
+            if( (cursorPosition.x >= DISPLAY_WIDTH-sizeof(FONT[0])) || ((uint8_t)c < ' ') ) break;
             // mapping char
-            c -= ' ';
-            if (c >= pgm_read_byte(&special_char[0][1]) ) {
-                char temp = c;
-                c = 0xff;
-                for (uint8_t i=0; pgm_read_byte(&special_char[i][1]) != 0xff; i++) {
-                    if ( pgm_read_byte(&special_char[i][0])-' ' == temp ) {
-                        c = pgm_read_byte(&special_char[i][1]);
-                        break;
-                    }
-                }
-                if ( c == 0xff ) break;
-            }
+            glyph = oled_glyph(c);
+            if (glyph == 0xff) break;
             // print char at display
 #ifdef GRAPHICMODE
             if (charMode == DOUBLESIZE) {
                 uint16_t doubleChar[sizeof(FONT[0])];
                 uint8_t dChar;
                 if ((cursorPosition.x+2*sizeof(FONT[0]))>DISPLAY_WIDTH) break;
+                if (cursorPosition.y >= DISPLAY_HEIGHT/8-1) break;  // lower half below last page
                 
                 for (uint8_t i=0; i < sizeof(FONT[0]); i++) {
-                    doubleChar[i] = 0;
-                    dChar = pgm_read_byte(&(FONT[(uint8_t)c][i]));
-                    for (uint8_t j=0; j<8; j++) {
-                        if ((dChar & (1 << j))) {
-                            doubleChar[i] |= (1 << (j*2));
-                            doubleChar[i] |= (1 << ((j*2)+1));
-                        }
-                    }
+                    dChar = pgm_read_byte(&(FONT[glyph][i]));
+                    doubleChar[i] = (pgm_read_byte(&double_nibble[dChar >> 4]) << 8) |
+                                    pgm_read_byte(&double_nibble[dChar & 0x0f]);
                 }
                 for (uint8_t i = 0; i < sizeof(FONT[0]); i++)
                 {
@@ -291,6 +392,8 @@ void oled_putc(char c){
                     displayBuffer[cursorPosition.y][cursorPosition.x+(2*i)] = doubleChar[i] & 0xff;
                     displayBuffer[cursorPosition.y][cursorPosition.x+(2*i)+1] = doubleChar[i] & 0xff;
                 }
+                oled_mark_dirty(cursorPosition.y, cursorPosition.x, 2*sizeof(FONT[0]));
+                oled_mark_dirty(cursorPosition.y+1, cursorPosition.x, 2*sizeof(FONT[0]));
                 cursorPosition.x += sizeof(FONT[0])*2;
             } else {
             	if ((cursorPosition.x+sizeof(FONT[0]))>DISPLAY_WIDTH) break;
@@ -298,8 +401,9 @@ void oled_putc(char c){
                 for (uint8_t i = 0; i < sizeof(FONT[0]); i++)
                 {
                     // load bit-pattern from flash
-                    displayBuffer[cursorPosition.y][cursorPosition.x+i] =pgm_read_byte(&(FONT[(uint8_t)c][i]));
+                    displayBuffer[cursorPosition.y][cursorPosition.x+i] =pgm_read_byte(&(FONT[glyph][i]));
                 }
+                oled_mark_dirty(cursorPosition.y, cursorPosition.x, sizeof(FONT[0]));
                 cursorPosition.x += sizeof(FONT[0]);
             }
 #elif defined TEXTMODE
@@ -309,14 +413,9 @@ void oled_putc(char c){
                 if ((cursorPosition.x+2*sizeof(FONT[0]))>DISPLAY_WIDTH) break;
                 
                 for (uint8_t i=0; i < sizeof(FONT[0]); i++) {
-                    doubleChar[i] = 0;
-                    dChar = pgm_read_byte(&(FONT[(uint8_t)c][i]));
-                    for (uint8_t j=0; j<8; j++) {
-                        if ((dChar & (1 << j))) {
-                            doubleChar[i] |= (1 << (j*2));
-                            doubleChar[i] |= (1 << ((j*2)+1));
-                        }
-                    }
+                    dChar = pgm_read_byte(&(FONT[glyph][i]));
+                    doubleChar[i] = (pgm_read_byte(&double_nibble[dChar >> 4]) << 8) |
+                                    pgm_read_byte(&double_nibble[dChar & 0x0f]);
                 }
                 uint8_t data[sizeof(FONT[0])*2];
                 for (uint8_t i = 0; i < sizeof(FONT[0]); i++)
@@ -365,7 +464,7 @@ void oled_putc(char c){
             	for (uint8_t i = 0; i < sizeof(FONT[0]); i++)
                 {
                     // print font to ram, print 6 columns
-                    data[i]=(pgm_read_byte(&(FONT[(uint8_t)c][i])));
+                    data[i]=(pgm_read_byte(&(FONT[glyph][i])));
                 }
                 oled_data(data, sizeof(FONT[0]));
                 cursorPosition.x += sizeof(FONT[0]);
@@ -408,9 +507,38 @@ void oled_flip(uint8_t flipping){
 	}
 }
 void oled_puts(const char* s){
+#ifdef GRAPHICMODE
+    while (*s) {
+        if (charMode != NORMALSIZE || (uint8_t)*s < ' ') {
+            oled_putc(*s++);
+            continue;
+        }
+        // blit a run of printable chars straight into the buffer,
+        // room is the number of chars still fitting in the line
+        uint8_t x = cursorPosition.x;
+        uint8_t room = 0;
+        if (x < DISPLAY_WIDTH-sizeof(FONT[0])) {
+            room = (DISPLAY_WIDTH-sizeof(FONT[0])-1-x)/sizeof(FONT[0])+1;
+        }
+        uint8_t *dst = &displayBuffer[cursorPosition.y][x];
+        while ((uint8_t)*s >= ' ') {
+            uint8_t glyph = oled_glyph(*s++);
+            if (glyph == 0xff || room == 0) continue;
+            memcpy_P(dst, FONT[glyph], sizeof(FONT[0]));
+            dst += sizeof(FONT[0]);
+            room--;
+        }
+        uint8_t width = dst - &displayBuffer[cursorPosition.y][x];
+        if (width) {
+            oled_mark_dirty(cursorPosition.y, x, width);
+            cursorPosition.x = x + width;
+        }
+    }
+#else
     while (*s) {
         oled_putc(*s++);
     }
+#endif
 }
 void oled_puts_p(const char* progmem_s){
     register uint8_t c;
@@ -429,6 +557,7 @@ uint8_t oled_drawPixel(uint8_t x, uint8_t y, uint8_t color){
     } else {
         displayBuffer[(y / 8)][x] &= ~(1 << (y % 8));
     }
+    oled_mark_dirty(y / 8, x, 1);
     
     return 0;
 }
@@ -531,20 +660,84 @@ uint8_t oled_drawBitmap(uint8_t x, uint8_t y, const uint8_t *picture, uint8_t wi
     }
     return result;
 }
+// returns 1 if the columns did not reach the display RAM
+static uint8_t oled_send_block(uint8_t x, uint8_t line, uint8_t width) {
+#if defined I2C && defined SH1106
+    return oled_page_write(x, line, &displayBuffer[line][x], width);
+#elif defined I2C
+    oled_goto_xpix_y(x,line);
+    return oled_twi_write(0x40, &displayBuffer[line][x], width);
+#else
+    oled_goto_xpix_y(x,line);
+    oled_data(&displayBuffer[line][x], width);
+    return 0;
+#endif
+}
+// send columns and record them in the shadow, or keep them dirty for the
+// next flush when the transfer failed (returns 1 then)
+static uint8_t oled_send_synced(uint8_t x, uint8_t line, uint8_t width) {
+    if (oled_send_block(x, line, width)) {
+        oled_mark_dirty(line, x, width);
+#if OLED_SHADOW != OLED_SHADOW_NONE
+        oled_shadow_lost(x, line, width);
+#endif
+        return 1;
+    }
+#if OLED_SHADOW != OLED_SHADOW_NONE
+    oled_shadow_sync(x, line, width);
+#endif
+    return 0;
+}
 void oled_display() {
-#if defined (SSD1306) || defined (SSD1309)
+    oled_mark_clean();
+#if OLED_SHADOW != OLED_SHADOW_NONE
+    // send runs of blocks that differ from the display RAM
+    for (uint8_t i = 0; i < DISPLAY_HEIGHT/8; i++){
+        uint8_t run = SHADOW_BLOCKS;
+        for (uint8_t b = 0; b <= SHADOW_BLOCKS; b++) {
+            if (b < SHADOW_BLOCKS && oled_shadow_changed(i, b)) {
+                if (run == SHADOW_BLOCKS) run = b;
+            } else if (run != SHADOW_BLOCKS) {
+                oled_send_synced(run*SHADOW_BLOCK, i, (b-run)*SHADOW_BLOCK);
+                run = SHADOW_BLOCKS;
+            }
+        }
+    }
+#elif defined (SSD1306) || defined (SSD1309)
     oled_gotoxy(0,0);
-    oled_data(&displayBuffer[0][0], DISPLAY_WIDTH*DISPLAY_HEIGHT/8);
+    // one transfer per page, so queued sensor reads get the bus in between
+    for (uint8_t i = 0; i < DISPLAY_HEIGHT/8; i++){
+        oled_data(displayBuffer[i], sizeof(displayBuffer[i]));
+    }
 #elif defined SH1106
     for (uint8_t i = 0; i < DISPLAY_HEIGHT/8; i++){
+# if defined I2C
+        if (oled_page_write(0, i, displayBuffer[i], sizeof(displayBuffer[i]))) {
+            oled_mark_dirty(i, 0, DISPLAY_WIDTH);  // send it with the next frame
+        }
+# else
         oled_gotoxy(0,i);
         oled_data(displayBuffer[i], sizeof(displayBuffer[i]));
+# endif
     }
 #endif
 }
+uint16_t oled_display_dirty(void) {
+    uint16_t sent = 0;
+    for (uint8_t i = 0; i < DISPLAY_HEIGHT/8; i++){
+        if (dirtyTo[i] > dirtyFrom[i]) {
+            uint8_t x = dirtyFrom[i], width = dirtyTo[i] - dirtyFrom[i];
+            dirtyFrom[i] = dirtyTo[i] = 0;
+            oled_send_synced(x, i, width);
+            sent += width;
+        }
+    }
+    return DISPLAY_WIDTH*DISPLAY_HEIGHT/8 - sent;
+}
 void oled_clear_buffer() {
     for (uint8_t i = 0; i < DISPLAY_HEIGHT/8; i++){
         memset(displayBuffer[i], 0x00, sizeof(displayBuffer[i]));
+        oled_mark_dirty(i, 0, DISPLAY_WIDTH);
     }
 }
 uint8_t oled_check_buffer(uint8_t x, uint8_t y) {
@@ -556,7 +749,95 @@ void oled_display_block(uint8_t x, uint8_t line, uint8_t width) {
     if (x + width > DISPLAY_WIDTH) { // no -1 here, x alone is width 1
         width = DISPLAY_WIDTH - x;
     }
-    oled_goto_xpix_y(x,line);
-    oled_data(&displayBuffer[line][x], width);
+    oled_send_synced(x, line, width);
+}
+// #pragma mark -
+// #pragma mark NON-BLOCKING FLUSH
+static struct {
+    uint8_t from[DISPLAY_HEIGHT/8];  // columns of the frame still to send
+    uint8_t to[DISPLAY_HEIGHT/8];
+    uint8_t line;                    // page in progress, DISPLAY_HEIGHT/8 = idle
+    uint8_t chunkLine, x, width;     // chunk on the bus, kept across oled_display_begin()
+    uint8_t failed;                  // a chunk of this flush went back to the dirty spans
+    void (*callback)(uint8_t complete);
+#if defined I2C && defined SH1106
+    uint8_t prefix[PAGE_PREFIX_SIZE];
+    twi_iov_t payload;
+    twi_xfer_t xfer;
+#endif
+} flush = { .line = DISPLAY_HEIGHT/8 };
+void oled_display_begin(void (*callback)(uint8_t complete)) {
+    // columns of an unfinished frame go into the new one
+    for (uint8_t i = flush.line; i < DISPLAY_HEIGHT/8; i++) {
+        if (flush.to[i] > flush.from[i]) {
+            oled_mark_dirty(i, flush.from[i], flush.to[i] - flush.from[i]);
+        }
+    }
+    memcpy(flush.from, dirtyFrom, sizeof(flush.from));
+    memcpy(flush.to, dirtyTo, sizeof(flush.to));
+    oled_mark_clean();
+    flush.line = 0;
+    flush.failed = 0;
+    flush.callback = callback;
+}
+uint8_t oled_display_step(uint8_t budget) {
+    if (flush.line >= DISPLAY_HEIGHT/8) return 0;
+#if defined I2C && defined SH1106
+    if (flush.xfer.status == TWI_XFER_PENDING) return 1;  // chunk still on the bus
+    if (flush.xfer.status == TWI_XFER_ERROR && flush.width != 0) {
+        oled_mark_dirty(flush.chunkLine, flush.x, flush.width);  // send it with the next frame
+        flush.failed = 1;
+# if OLED_SHADOW != OLED_SHADOW_NONE
+        oled_shadow_lost(flush.x, flush.chunkLine, flush.width);
+    } else if (flush.xfer.status == TWI_XFER_DONE && flush.width != 0) {
+        oled_shadow_sync(flush.x, flush.chunkLine, flush.width);  // chunk is in the display RAM
+# endif
+    }
+    flush.xfer.status = TWI_XFER_IDLE;
+#endif
+    while (flush.line < DISPLAY_HEIGHT/8 && flush.to[flush.line] <= flush.from[flush.line]) {
+        flush.line++;
+    }
+    if (flush.line >= DISPLAY_HEIGHT/8) {
+        void (*callback)(uint8_t complete) = flush.callback;
+        flush.callback = NULL;
+        if (callback != NULL) callback(!flush.failed);  // 1: whole frame is on the panel
+        return 0;
+    }
+    if (budget == 0 || budget > DISPLAY_WIDTH) budget = DISPLAY_WIDTH;
+    flush.chunkLine = flush.line;
+    flush.x = flush.from[flush.line];
+    flush.width = flush.to[flush.line] - flush.x;
+    if (flush.width > budget) flush.width = budget;
+    flush.from[flush.line] += flush.width;
+#if defined I2C && defined SH1106
+    oled_page_prefix(flush.prefix, flush.x, flush.line);
+    flush.payload.buf = &displayBuffer[flush.line][flush.x];
+    flush.payload.len = flush.width;
+    flush.xfer = (twi_xfer_t){
+        .addr = OLED_I2C_ADR,
+        .prio = TWI_PRIO_LOW,
+        .wbuf = flush.prefix,
+        .wlen = sizeof(flush.prefix),
+        .wiov = &flush.payload,
+        .wiovcnt = 1,
+    };
+    if (twi_submit(&flush.xfer)) {
+        flush.from[flush.line] -= flush.width;  // queue full, try again next step
+        flush.width = 0;
+        return 1;
+    }
+#else
+    flush.failed |= oled_send_synced(flush.x, flush.line, flush.width);
+#endif
+    return 1;
+}
+
+uint8_t oled_display_pending(void) {
+    if (flush.line >= DISPLAY_HEIGHT/8) return 0;
+#if defined I2C && defined SH1106
+    if (flush.xfer.status == TWI_XFER_PENDING) return 0;  // the TWI interrupt finishes it
+#endif
+    return 1;
 }
 #endif
\ No newline at end of file
@@ -64,10 +64,31 @@ extern "C" {
     // TEXTMODE // for only text to display,
     /* TODO: define font */
 #define FONT  ssd1306oled_font  // Refer font-name at font.h
+    /* TODO: define flush mode (GRAPHICMODE) */
+#define OLED_SHADOW_NONE     0  // send every column on oled_display()
+#define OLED_SHADOW_FULL     1  // keep a copy of the panel RAM, send changed 16-column blocks
+#define OLED_SHADOW_CHECKSUM 2  // keep a CRC-16 per 16-column block, send changed blocks
+#ifndef OLED_SHADOW
+# define OLED_SHADOW OLED_SHADOW_NONE
+#endif
+    // RAM and cost of oled_display() for a 128x64 panel, I2C at 400 kHz, 16 MHz.
+    // RAM and bus bytes are the output of the shadow benchmark in the host
+    // tests (test/oled_bench.h, one row per test_oled* suite), the screen
+    // of main.c with all 5 fields rewritten and 3 of them changed. Bus time
+    // is 22.5 us per byte; the CPU times are estimates from cycle counts,
+    // not measured (the "twi" UART command measures the bus part):
+    //
+    //  mode       extra RAM   unchanged frame           5 fields rewritten
+    //  NONE          0 B      1120 B, 25.2 ms bus       1120 B, 25.2 ms bus
+    //  CHECKSUM    136 B         0 B, ~1.4 ms CPU (CRC)  100 B, 2.2 ms bus + ~1.4 ms CPU
+    //  FULL       1032 B         0 B, ~0.4 ms CPU (cmp)  100 B, 2.2 ms bus + ~0.4 ms CPU
+    //
+    // FULL does not fit next to the frame buffer in the 2 KB of an ATmega328P.
     
     // using 7-bit-adress for lcd-library
     // if you use your own library for twi check I2C-adress-handle
 #define OLED_I2C_ADR (0x3c)  // 7 bit slave-adress without r/w-bit
+#define OLED_I2C_SPEED TWI_SPEED_FAST  // SCL for the display, other devices keep their own
     // e.g. 8 bit slave-adress:
     // 0x78 = adress 0x3C with cleared r/w-bit (write-mode)
 
@@ -135,7 +156,18 @@ void oled_flip(uint8_t flipping);  // flip display,
     uint8_t oled_fillCircle(uint8_t center_x, uint8_t center_y, uint8_t radius, uint8_t color);
     uint8_t oled_drawBitmap(uint8_t x, uint8_t y, const uint8_t picture[], uint8_t width, uint8_t height, uint8_t color);
     void oled_display(void);       // copy buffer to display RAM
+    uint16_t oled_display_dirty(void);  // copy only columns changed since last flush,
+                                        // returns data bytes saved against oled_display()
     void oled_clear_buffer(void);  // clear display buffer
+    void oled_display_begin(void (*callback)(uint8_t complete));  // start a non-blocking flush of the
+                                        // columns changed since last flush, callback (or NULL) runs when
+                                        // done with complete = 0 if a chunk failed and stays dirty for
+                                        // the next flush; an unfinished frame and a chunk on the bus
+                                        // are carried over
+    uint8_t oled_display_step(uint8_t budget);  // send up to budget bytes (0 = one page) of the
+                                        // frame, returns 1 while the frame is in progress
+    uint8_t oled_display_pending(void);  // 1 when oled_display_step() can send data now
+                                        // (0 when done or a chunk is still on the bus)
     uint8_t oled_check_buffer(uint8_t x, uint8_t y); // read a pixel value from the display buffer
     void oled_display_block(uint8_t x, uint8_t line, uint8_t width); // display (part of) a display line
 #endif
@@ -0,0 +1,251 @@
+/*
+ * Cooperative task scheduler for AVR-GCC.
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno board and ATmega328P, 16 MHz.
+ */
+
+// -- Includes ---------------------------------------------
+#include <sched.h>
+#include <stddef.h>
+#include <util/atomic.h>
+
+
+// -- Local data -------------------------------------------
+static sched_task_t *sched_tasks = NULL;
+static uint8_t sched_count = 0;
+static volatile uint32_t sched_tick_count = 0;
+static uint32_t sched_next = 0;             // Earliest release
+static volatile uint8_t sched_due = 1;      // Tick reached sched_next
+
+
+// -- Local functions --------------------------------------
+
+/*
+ * Function: sched_us()
+ * Purpose:  Timer counts to µs, saturated to 16 bits.
+ * Input:    counts - time difference
+ * Returns:  µs
+ */
+static uint16_t sched_us(uint32_t counts)
+{
+    if (counts >= 0xFFFFUL / SCHED_SUBTICK_US)
+        return 0xFFFF;
+    return counts * SCHED_SUBTICK_US;
+}
+
+
+// -- Function definitions ---------------------------------
+/*
+ * Function: sched_init()
+ * Purpose:  Take the task table and set the first releases.
+ * Input:    tasks - table, highest priority first
+ *           count - number of entries
+ * Returns:  none
+ */
+void sched_init(sched_task_t *tasks, uint8_t count)
+{
+    uint32_t now = sched_ticks();
+    uint8_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        tasks[i].release = now + tasks[i].offset;
+        tasks[i].stats = (sched_stats_t){ 0 };
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        sched_tasks = tasks;
+        sched_count = count;
+    }
+}
+
+
+/*
+ * Function: sched_clock()
+ * Purpose:  Current time in timer counts (tick * top + counter).
+ * Returns:  Time, wraps with the 32-bit product
+ */
+uint32_t sched_clock(void)
+{
+    uint32_t ticks;
+    uint8_t sub;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        sub = SCHED_SUBTICK();
+        ticks = sched_tick_count;
+        // The counter wrapped but the ISR has not run yet
+        if (SCHED_TICK_PENDING() && sub < SCHED_SUBTICK_TOP / 2)
+            ticks++;
+    }
+    return ticks * SCHED_SUBTICK_TOP + sub;
+}
+
+
+/*
+ * Function: sched_tick()
+ * Purpose:  Count one tick, from the timer ISR.
+ * Returns:  none
+ */
+void sched_tick(void)
+{
+    sched_tick_count++;
+    if ((int32_t)(sched_tick_count - sched_next) >= 0)
+        sched_due = 1;
+}
+
+
+/*
+ * Function: sched_run()
+ * Purpose:  Run the first released task of the table and update its
+ *           statistics.
+ * Returns:  1 when a task ran, 0 otherwise
+ */
+uint8_t sched_run(void)
+{
+    uint32_t now = sched_ticks();
+    uint32_t start, end, release, late;
+    uint16_t jitter;
+    sched_task_t *t;
+    uint8_t i;
+
+    for (i = 0; i < sched_count; i++)
+    {
+        t = &sched_tasks[i];
+        if ((int32_t)(now - t->release) >= 0)
+            break;
+    }
+    if (i == sched_count)
+    {
+        // Nothing released: note the earliest release for sched_tick()
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            sched_next = now + 0x7FFFFFFFUL;
+            for (i = 0; i < sched_count; i++)
+            {
+                if ((int32_t)(sched_tasks[i].release - sched_next) < 0)
+                    sched_next = sched_tasks[i].release;
+            }
+            sched_due = (int32_t)(sched_tick_count - sched_next) >= 0;
+        }
+        return 0;
+    }
+
+    // A whole period late: drop the missed releases, run once
+    late = now - t->release;
+    if (late >= t->period)
+    {
+        t->stats.skipped += late / t->period;
+        t->release += (late / t->period) * t->period;
+    }
+    release = t->release * SCHED_SUBTICK_TOP;
+    t->release += t->period;
+
+    start = sched_clock();
+    t->run();
+    end = sched_clock();
+
+    t->stats.runs++;
+    t->stats.runtime_last = sched_us(end - start);
+    if (t->stats.runtime_last > t->stats.runtime_max)
+        t->stats.runtime_max = t->stats.runtime_last;
+    jitter = sched_us(start - release);
+    if (jitter > t->stats.jitter_max)
+        t->stats.jitter_max = jitter;
+    if ((int32_t)(end - release) > (int32_t)t->deadline * SCHED_SUBTICK_TOP)
+        t->stats.overruns++;
+
+    return 1;
+}
+
+
+/*
+ * Function: sched_set_period()
+ * Purpose:  Change the period of a task, bring its release forward
+ *           when it is more than the new period away.
+ * Input:    id     - table index
+ *           period - ticks between releases
+ * Returns:  none
+ */
+void sched_set_period(uint8_t id, uint16_t period)
+{
+    uint32_t next;
+    sched_task_t *t;
+
+    if (id >= sched_count || period == 0)
+        return;
+
+    t = &sched_tasks[id];
+    t->period = period;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        next = sched_tick_count + period;
+        if ((int32_t)(t->release - next) > 0)
+            t->release = next;
+        // sched_tick() only wakes the loop at sched_next
+        if ((int32_t)(t->release - sched_next) < 0)
+            sched_next = t->release;
+    }
+}
+
+
+/*
+ * Function: sched_pending()
+ * Purpose:  Check for a released task.
+ * Returns:  1 when sched_run() has work
+ */
+uint8_t sched_pending(void)
+{
+    return sched_due;
+}
+
+
+/*
+ * Function: sched_ticks()
+ * Purpose:  Ticks since power-up.
+ * Returns:  Tick count
+ */
+uint32_t sched_ticks(void)
+{
+    uint32_t ticks;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ticks = sched_tick_count;
+    }
+    return ticks;
+}
+
+
+/*
+ * Function: sched_get_stats()
+ * Purpose:  Copy the statistics of a task.
+ * Input:    id    - table index
+ *           stats - destination
+ * Returns:  Task name, NULL for an invalid id
+ */
+const char *sched_get_stats(uint8_t id, sched_stats_t *stats)
+{
+    if (id >= sched_count)
+        return NULL;
+
+    *stats = sched_tasks[id].stats;
+    return sched_tasks[id].name;
+}
+
+
+/*
+ * Function: sched_reset_stats()
+ * Purpose:  Clear the statistics of all tasks.
+ * Returns:  none
+ */
+void sched_reset_stats(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < sched_count; i++)
+        sched_tasks[i].stats = (sched_stats_t){ 0 };
+}
@@ -0,0 +1,197 @@
+#ifndef SCHED_H
+#define SCHED_H
+/*
+ * Cooperative task scheduler for AVR-GCC.
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno (ATmega328P, 16 MHz).
+ *
+ * Runs periodic work from the main loop; the timer interrupt only
+ * counts ticks.
+ */
+
+/**
+ * @file
+ * @defgroup sched Scheduler <sched.h>
+ * @code #include <sched.h> @endcode
+ *
+ * @brief Static-table, tick-driven cooperative scheduler with timing
+ *        statistics.
+ *
+ * The application declares its tasks in a table; each has a period, a
+ * first release (offset) and a deadline, all in ticks. The timer ISR
+ * calls sched_tick() and nothing else; sched_run() in the main loop
+ * starts the first released task of the table (table order is the
+ * priority) and returns, so background work in the loop keeps running
+ * between tasks. Tasks must not block.
+ *
+ * For every task the scheduler keeps:
+ *  - runtime: last and longest, in µs,
+ *  - jitter: longest delay from release to start, in µs,
+ *  - overruns: runs that finished after release + deadline,
+ *  - skipped: releases dropped because the task was a whole period late.
+ *
+ * Times come from the tick count and the tick timer's counter
+ * (::SCHED_SUBTICK), so the resolution is one timer count. The
+ * defaults fit the 1 ms Timer2 CTC tick of systime_init(): 250 counts
+ * of 4 µs per tick.
+ *
+ * @code
+ *   static sched_task_t tasks[] = {
+ *       { .run = task_measure, .name = "meas", .period = 1000, .deadline = 30 },
+ *   };
+ *   sched_init(tasks, 1);
+ *   ISR(TIMER2_COMPA_vect) { systime_tick(); sched_tick(); }
+ *   while (1) { sched_run(); ... }
+ * @endcode
+ * @{
+ */
+
+#include <avr/io.h>
+#include <stdint.h>
+
+
+// -----------------------------------------------------------------------------
+//  Configuration
+// -----------------------------------------------------------------------------
+
+/** @brief Tick period, µs (Timer2 compare match A, CTC mode). */
+#ifndef SCHED_TICK_US
+#define SCHED_TICK_US 1000UL
+#endif
+
+/** @brief Timer counter within the current tick. */
+#ifndef SCHED_SUBTICK
+#define SCHED_SUBTICK() TCNT2
+#endif
+
+/** @brief Timer counts per tick. */
+#ifndef SCHED_SUBTICK_TOP
+#define SCHED_SUBTICK_TOP 250
+#endif
+
+/** @brief Tick interrupt flag, set while the tick is not counted yet. */
+#ifndef SCHED_TICK_PENDING
+#define SCHED_TICK_PENDING() (TIFR2 & (1 << OCF2A))
+#endif
+
+#define SCHED_SUBTICK_US (SCHED_TICK_US / SCHED_SUBTICK_TOP)
+
+
+// -----------------------------------------------------------------------------
+//  Types
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Timing statistics of one task.
+ */
+typedef struct {
+    uint16_t runs;              /**< Completed runs */
+    uint16_t overruns;          /**< Finished after release + deadline */
+    uint16_t skipped;           /**< Releases dropped, task a period late */
+    uint16_t runtime_last;      /**< µs, saturated at 65535 */
+    uint16_t runtime_max;       /**< µs */
+    uint16_t jitter_max;        /**< Release to start, µs */
+} sched_stats_t;
+
+/**
+ * @brief Table entry: configuration (set by the application) and state.
+ */
+typedef struct {
+    void (*run)(void);          /**< Task body, must not block */
+    const char *name;           /**< For reports */
+    uint16_t period;            /**< Ticks between releases */
+    uint16_t offset;            /**< First release, ticks after sched_init() */
+    uint16_t deadline;          /**< Ticks after release to finish by */
+    uint32_t release;           /**< Internal: next release tick */
+    sched_stats_t stats;        /**< Internal: see sched_get_stats() */
+} sched_task_t;
+
+
+// -----------------------------------------------------------------------------
+//  Function prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Take a task table and schedule the first releases.
+ *
+ * @param tasks  Table, highest priority first; must stay valid.
+ * @param count  Number of entries.
+ */
+void sched_init(sched_task_t *tasks, uint8_t count);
+
+
+/**
+ * @brief Count one tick. The only call needed in the timer ISR.
+ */
+void sched_tick(void);
+
+
+/**
+ * @brief Run the first released task, if any.
+ *
+ * Call from the main loop.
+ *
+ * @return 1 if a task ran, 0 if none was due.
+ */
+uint8_t sched_run(void);
+
+
+/**
+ * @brief Change the period of a task.
+ *
+ * Call from the main loop, not from an ISR. A release further away
+ * than the new period is brought forward to one period from now, so a
+ * shorter period takes effect at once.
+ *
+ * @param id      Table index.
+ * @param period  Ticks between releases, not 0.
+ */
+void sched_set_period(uint8_t id, uint16_t period);
+
+
+/**
+ * @brief Check for a released task without running it.
+ *
+ * Cheap enough for the sleep condition of the main loop.
+ *
+ * @return 1 if sched_run() has a task to run.
+ */
+uint8_t sched_pending(void);
+
+
+/**
+ * @brief Time in timer counts of ::SCHED_SUBTICK_US.
+ *
+ * @return Tick count × ::SCHED_SUBTICK_TOP + timer counter, wrapping.
+ */
+uint32_t sched_clock(void);
+
+
+/**
+ * @brief Ticks since power-up.
+ *
+ * @return Tick count.
+ */
+uint32_t sched_ticks(void);
+
+
+/**
+ * @brief Copy the statistics of a task.
+ *
+ * @param id     Table index.
+ * @param stats  Where to store them.
+ * @return Task name, NULL if @p id is out of range.
+ */
+const char *sched_get_stats(uint8_t id, sched_stats_t *stats);
+
+
+/**
+ * @brief Clear the statistics of all tasks.
+ */
+void sched_reset_stats(void);
+
+
+/** @} */
+
+#endif
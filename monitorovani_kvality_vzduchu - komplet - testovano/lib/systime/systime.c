@@ -0,0 +1,105 @@
+/*
+ * Millisecond time base for AVR-GCC.
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno board and ATmega328P, 16 MHz.
+ */
+
+// -- Includes ---------------------------------------------
+#include <systime.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "timer.h"
+
+
+// -- Local data -------------------------------------------
+static volatile uint32_t systime_lo = 0;    // ms, wraps
+static volatile uint32_t systime_hi = 0;    // Wraps of systime_lo
+
+
+// -- Function definitions ---------------------------------
+/*
+ * Function: systime_init()
+ * Purpose:  Timer2 in CTC mode, compare match A every 1 ms.
+ * Returns:  none
+ */
+void systime_init(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        systime_lo = 0;
+        systime_hi = 0;
+        TCNT2 = 0;
+        tim2_ctc_1ms();
+        tim2_compa_enable();
+    }
+}
+
+
+/*
+ * Function: systime_tick()
+ * Purpose:  Count one ms, from ISR(TIMER2_COMPA_vect).
+ * Returns:  none
+ */
+void systime_tick(void)
+{
+    if (++systime_lo == 0)
+        systime_hi++;
+}
+
+
+/*
+ * Function: systime_ms()
+ * Purpose:  Read the 32-bit ms count.
+ * Returns:  ms since systime_init()
+ */
+uint32_t systime_ms(void)
+{
+    uint32_t ms;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ms = systime_lo;
+    }
+    return ms;
+}
+
+
+/*
+ * Function: systime_us()
+ * Purpose:  Read the ms count and the Timer2 counter as µs.
+ * Returns:  µs since systime_init(), wraps
+ */
+uint32_t systime_us(void)
+{
+    uint32_t ms;
+    uint8_t sub;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        sub = TCNT2;
+        ms = systime_lo;
+        // Compare match passed but the ISR has not counted it yet
+        if ((TIFR2 & (1 << OCF2A)) && sub < SYSTIME_COUNTS_PER_MS / 2)
+            ms++;
+    }
+    return ms * 1000 + sub * (1000 / SYSTIME_COUNTS_PER_MS);
+}
+
+
+/*
+ * Function: systime_ms64()
+ * Purpose:  Read the ms count with its wrap count.
+ * Returns:  ms since systime_init(), 64 bits
+ */
+uint64_t systime_ms64(void)
+{
+    uint32_t lo, hi;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        lo = systime_lo;
+        hi = systime_hi;
+    }
+    return ((uint64_t)hi << 32) | lo;
+}
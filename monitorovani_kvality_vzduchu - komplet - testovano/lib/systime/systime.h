@@ -0,0 +1,99 @@
+#ifndef SYSTIME_H
+#define SYSTIME_H
+/*
+ * Millisecond time base for AVR-GCC.
+ *
+ * Developed using PlatformIO and Atmel AVR platform.
+ * Tested on Arduino Uno (ATmega328P, 16 MHz).
+ *
+ * One clock for timestamps of sensor readings and for the scheduler
+ * tick.
+ */
+
+/**
+ * @file
+ * @defgroup systime Time Base <systime.h>
+ * @code #include <systime.h> @endcode
+ *
+ * @brief Exact 1 ms tick from Timer2 in CTC mode, 32- and 64-bit
+ *        counters.
+ *
+ * systime_init() runs Timer2 in CTC mode (prescaler 64, OCR2A = 249),
+ * so the compare match A interrupt comes every 1.000 ms, unlike the
+ * 16.384 ms of a free-running overflow. The application owns
+ * ISR(TIMER2_COMPA_vect) and calls systime_tick() from it, followed by
+ * anything else that runs on the tick (e.g. sched_tick()).
+ *
+ * systime_ms() wraps after 49.7 days; systime_ms64() extends it with a
+ * wrap count and does not wrap in practice. Both are read with
+ * interrupts off, so they are never torn, also from other ISRs.
+ * Differences of systime_ms() values stay correct across the wrap for
+ * intervals under 49 days.
+ *
+ * @code
+ *   systime_init();
+ *   ISR(TIMER2_COMPA_vect) { systime_tick(); }
+ *   ...
+ *   uint32_t stamp = systime_ms();
+ * @endcode
+ * @{
+ */
+
+#include <stdint.h>
+
+
+// -----------------------------------------------------------------------------
+//  Configuration
+// -----------------------------------------------------------------------------
+
+/** @brief Timer2 counts per ms (16 MHz / 64). */
+#define SYSTIME_COUNTS_PER_MS 250
+
+
+// -----------------------------------------------------------------------------
+//  Function prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Start Timer2 in CTC mode with the compare A interrupt, 1 ms.
+ *
+ * Interrupts must be enabled by the caller.
+ */
+void systime_init(void);
+
+
+/**
+ * @brief Count one millisecond. Call from ISR(TIMER2_COMPA_vect).
+ */
+void systime_tick(void);
+
+
+/**
+ * @brief Milliseconds since systime_init().
+ *
+ * @return 32-bit count, wraps after 2^32 ms.
+ */
+uint32_t systime_ms(void);
+
+
+/**
+ * @brief Microseconds since systime_init(), 4 µs resolution.
+ *
+ * For short intervals (e.g. bus latencies); wraps after 71 minutes.
+ *
+ * @return 32-bit count.
+ */
+uint32_t systime_us(void);
+
+
+/**
+ * @brief Milliseconds since systime_init(), extended to 64 bits.
+ *
+ * @return 64-bit count.
+ */
+uint64_t systime_ms64(void);
+
+
+/** @} */
+
+#endif
@@ -8,6 +8,458 @@
 
 // -- Includes ---------------------------------------------
 #include <twi.h>   // Header file with macros and function declarations
+#include <systime.h>       // Wait and latency times
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <util/delay.h>
+#include <stddef.h>
+
+
+// -- Transaction engine state -----------------------------
+
+/* TWCR value that continues the current bus operation with interrupt */
+#define TWI_CONTINUE ((1<<TWINT) | (1<<TWEN) | (1<<TWIE))
+
+/* Progress of a blocking wait loop, see twi_poll() */
+typedef struct {
+    uint16_t events;    // twi_events seen last
+    uint16_t idle_us;   // time without a bus event
+} twi_watch_t;
+
+#define TWI_POLL_US 10  // Wait loop granularity
+
+/* Phases of a running transaction */
+#define TWI_PHASE_MEMADDR 0  // memory/register address still to be sent
+#define TWI_PHASE_WRITE   1  // transmitting wbuf
+#define TWI_PHASE_READ    2  // receiving into rbuf
+
+#define TWI_QUEUE_MASK (TWI_QUEUE_SIZE - 1)
+#if (TWI_QUEUE_SIZE & TWI_QUEUE_MASK)
+# error TWI_QUEUE_SIZE is not a power of 2
+#endif
+
+/* Every access to the TWI unit and to the bus lines goes through these
+   macros, so a host build can put a simulated peripheral in their place
+   (TWI_HW_SIM, see twi.h) */
+#ifndef TWI_HW_SIM
+# define TWI_CR_READ()      TWCR
+# define TWI_CR_WRITE(v)    (TWCR = (v))
+# define TWI_SR_READ()      TWSR
+# define TWI_SR_WRITE(v)    (TWSR = (v))
+# define TWI_DR_READ()      TWDR
+# define TWI_DR_WRITE(v)    (TWDR = (v))
+# define TWI_BR_WRITE(v)    (TWBR = (v))
+/* Open-drain control of the bus lines while the TWI unit is disabled */
+# define TWI_LINE_LOW(pin)  do { TWI_PORT &= ~(1<<(pin)); DDR(TWI_PORT) |= (1<<(pin)); } while (0)
+# define TWI_LINE_HIGH(pin) do { DDR(TWI_PORT) &= ~(1<<(pin)); TWI_PORT |= (1<<(pin)); } while (0)
+#else
+# define TWI_CR_READ()      twi_sim_read(TWI_SIM_TWCR)
+# define TWI_CR_WRITE(v)    twi_sim_write(TWI_SIM_TWCR, (v))
+# define TWI_SR_READ()      twi_sim_read(TWI_SIM_TWSR)
+# define TWI_SR_WRITE(v)    twi_sim_write(TWI_SIM_TWSR, (v))
+# define TWI_DR_READ()      twi_sim_read(TWI_SIM_TWDR)
+# define TWI_DR_WRITE(v)    twi_sim_write(TWI_SIM_TWDR, (v))
+# define TWI_BR_WRITE(v)    twi_sim_write(TWI_SIM_TWBR, (v))
+# define TWI_LINE_LOW(pin)  twi_sim_line((pin), 0)
+# define TWI_LINE_HIGH(pin) twi_sim_line((pin), 1)
+#endif
+
+static twi_xfer_t * volatile twi_cur = NULL;  // Transaction owning the bus
+static uint8_t twi_idx;                       // Byte index in rbuf
+static uint8_t twi_phase;
+static const uint8_t *twi_wptr;               // Next byte to transmit
+static uint16_t twi_wleft;                    // Bytes left in current segment
+static uint8_t twi_wseg;                      // Next wiov segment
+static uint16_t twi_events;                   // Bus events since reset
+
+/* Waiting transactions, one ring buffer per priority level */
+static twi_xfer_t *twi_queue[TWI_PRIO_LEVELS][TWI_QUEUE_SIZE];
+static uint8_t twi_head[TWI_PRIO_LEVELS];
+static uint8_t twi_tail[TWI_PRIO_LEVELS];
+
+static twi_stats_t twi_stats;
+
+/* Default bit rate register value */
+static uint8_t twi_twbr = TWI_BIT_RATE_REG;
+
+/* Per slave address: bus speed and statistics */
+static struct {
+    uint8_t used;
+    uint8_t addr;
+    uint8_t twbr;                 // 0 = default bus speed
+    twi_dev_stats_t stats;
+} twi_devices[TWI_MAX_DEVICES];
+static uint8_t twi_dev;           // Entry of twi_cur's device, TWI_MAX_DEVICES = none
+
+
+// -- Local functions --------------------------------------
+
+/*
+ * Function: twi_bit_rate()
+ * Purpose:  Convert an SCL frequency to a TWBR value (prescaler = 1).
+ *           The result is limited to 10..255 as required by the hardware,
+ *           0 Hz gives the slowest rate.
+ */
+static uint8_t twi_bit_rate(uint32_t scl_hz)
+{
+    uint32_t ratio;
+
+    if (scl_hz == 0)
+        return 255;
+    ratio = F_CPU / scl_hz;
+    if (ratio < 16 + 2*10)
+        return 10;
+    if (ratio > 16 + 2*255)
+        return 255;
+    return (uint8_t)((ratio - 16) / 2);
+}
+
+
+/*
+ * Function: twi_device_slot()
+ * Purpose:  Find the device table entry of a slave address.
+ * Input:    addr   - 7-bit I2C slave address
+ *           create - allocate a free entry if the address is unknown
+ * Returns:  Entry index or TWI_MAX_DEVICES if not found / table full
+ */
+static uint8_t twi_device_slot(uint8_t addr, uint8_t create)
+{
+    uint8_t slot = TWI_MAX_DEVICES;
+
+    for (uint8_t i = 0; i < TWI_MAX_DEVICES; i++)
+    {
+        if (twi_devices[i].used && twi_devices[i].addr == addr)
+            return i;
+        if (!twi_devices[i].used && slot == TWI_MAX_DEVICES)
+            slot = i;
+    }
+    if (create && slot != TWI_MAX_DEVICES)
+    {
+        twi_devices[slot].used = 1;
+        twi_devices[slot].addr = addr;
+        twi_devices[slot].twbr = 0;
+    }
+    else
+    {
+        slot = TWI_MAX_DEVICES;
+    }
+    return slot;
+}
+
+
+/*
+ * Function: twi_dequeue()
+ * Purpose:  Remove the oldest waiting transaction of the highest
+ *           priority. Must be called with interrupts disabled.
+ * Returns:  Transaction descriptor or NULL if the queue is empty
+ */
+static twi_xfer_t *twi_dequeue(void)
+{
+    for (uint8_t p = 0; p < TWI_PRIO_LEVELS; p++)
+    {
+        if (twi_head[p] != twi_tail[p])
+        {
+            twi_xfer_t *xfer = twi_queue[p][twi_tail[p]];
+            twi_tail[p] = (twi_tail[p] + 1) & TWI_QUEUE_MASK;
+            twi_stats.depth--;
+            return xfer;
+        }
+    }
+    return NULL;
+}
+
+
+/*
+ * Function: twi_engine_rewind()
+ * Purpose:  Reset the byte position of the running transaction, used
+ *           for the first attempt and for every retry.
+ */
+static void twi_engine_rewind(twi_xfer_t *xfer)
+{
+    twi_idx = 0;
+    twi_wptr = xfer->wbuf;
+    twi_wleft = xfer->wlen;
+    twi_wseg = 0;
+    if (xfer->flags & TWI_XFER_MEMADDR)
+        twi_phase = TWI_PHASE_MEMADDR;
+    else if (xfer->wlen == 0 && xfer->wiovcnt == 0 && xfer->rlen != 0)
+        twi_phase = TWI_PHASE_READ;
+    else
+        twi_phase = TWI_PHASE_WRITE;
+}
+
+
+/*
+ * Function: twi_engine_load()
+ * Purpose:  Make xfer the transaction owning the bus and account for
+ *           the time it spent in the queue. The caller generates START.
+ */
+static void twi_engine_load(twi_xfer_t *xfer)
+{
+    uint32_t wait = systime_us() - xfer->queued_at;
+
+    twi_stats.total_wait[xfer->prio] += wait;
+    if (wait > twi_stats.max_wait[xfer->prio])
+        twi_stats.max_wait[xfer->prio] = wait;
+
+    /* Bus speed of the addressed device */
+    twi_dev = twi_device_slot(xfer->addr, 1);
+    if (twi_dev < TWI_MAX_DEVICES && twi_devices[twi_dev].twbr != 0)
+        TWI_BR_WRITE(twi_devices[twi_dev].twbr);
+    else
+        TWI_BR_WRITE(twi_twbr);
+
+    twi_cur = xfer;
+    twi_engine_rewind(xfer);
+}
+
+
+/*
+ * Function: twi_engine_report()
+ * Purpose:  Update statistics of a finished transaction, set its status
+ *           and run the completion callback.
+ */
+static void twi_engine_report(twi_xfer_t *xfer, uint8_t dev, uint8_t result)
+{
+    twi_stats.completed[xfer->prio]++;
+
+    if (dev < TWI_MAX_DEVICES)
+    {
+        twi_dev_stats_t *stats = &twi_devices[dev].stats;
+        uint32_t latency = systime_us() - xfer->queued_at;
+
+        stats->transfers++;
+        if (result != TWI_XFER_DONE)
+            stats->errors++;
+        stats->total_latency += latency;
+        if (latency > stats->max_latency)
+            stats->max_latency = latency;
+    }
+
+    xfer->status = result;
+    if (xfer->callback != NULL)
+        xfer->callback(xfer);
+}
+
+
+/*
+ * Function: twi_engine_next_byte()
+ * Purpose:  Load the next byte of wbuf/wiov into TWDR.
+ * Returns:  0 if a byte was loaded, 1 if all write data has been sent
+ */
+static uint8_t twi_engine_next_byte(twi_xfer_t *xfer)
+{
+    while (twi_wleft == 0)
+    {
+        if (twi_wseg >= xfer->wiovcnt)
+            return 1;
+        twi_wptr = xfer->wiov[twi_wseg].buf;
+        twi_wleft = xfer->wiov[twi_wseg].len;
+        twi_wseg++;
+    }
+    TWI_DR_WRITE(*twi_wptr++);
+    twi_wleft--;
+    return 0;
+}
+
+
+/*
+ * Function: twi_engine_finish()
+ * Purpose:  Report the result of the running transaction and hand the
+ *           bus to the next waiting one, or release it with STOP.
+ */
+static void twi_engine_finish(uint8_t result)
+{
+    twi_xfer_t *xfer = twi_cur;
+    uint8_t dev = twi_dev;
+    twi_xfer_t *next;
+
+    if (result != TWI_XFER_DONE && !(xfer->flags & TWI_XFER_NORETRY) &&
+        xfer->retries < TWI_RETRIES)
+    {
+        xfer->retries++;
+        if (dev < TWI_MAX_DEVICES)
+            twi_devices[dev].stats.retries++;
+        twi_engine_rewind(xfer);
+        TWI_CR_WRITE(TWI_CONTINUE | (1<<TWSTO) | (1<<TWSTA));  // STOP, try again
+        return;
+    }
+
+    next = twi_dequeue();
+
+    if (next != NULL)
+    {
+        twi_engine_load(next);
+        TWI_CR_WRITE(TWI_CONTINUE | (1<<TWSTO) | (1<<TWSTA));  // STOP, then START
+    }
+    else
+    {
+        TWI_CR_WRITE((1<<TWINT) | (1<<TWSTO) | (1<<TWEN));     // STOP, interrupt off
+        twi_cur = NULL;
+    }
+
+    twi_engine_report(xfer, dev, result);
+}
+
+
+/*
+ * Function: twi_wait_stop()
+ * Purpose:  Wait (bounded) until a STOP issued on the bus has finished.
+ */
+static void twi_wait_stop(void)
+{
+    for (uint8_t t = 0; (TWI_CR_READ() & (1<<TWSTO)) && t < 100; t++)
+        _delay_us(1);
+}
+
+
+/*
+ * Function: twi_wait_int()
+ * Purpose:  Wait (bounded) for the TWINT flag of a polled operation.
+ * Returns:  0 when the operation finished, 1 on timeout
+ */
+static uint8_t twi_wait_int(void)
+{
+    for (uint16_t t = 0; t < TWI_TIMEOUT_US; t++)
+    {
+        if (TWI_CR_READ() & (1<<TWINT))
+            return 0;
+        _delay_us(1);
+    }
+    return 1;
+}
+
+
+/*
+ * Function: twi_engine_step()
+ * Purpose:  Advance the running transaction by one bus event. Called
+ *           from ISR(TWI_vect) or polled when interrupts are disabled.
+ */
+static void twi_engine_step(void)
+{
+    twi_xfer_t *xfer = twi_cur;
+
+    if (xfer == NULL)
+        return;
+
+    twi_events++;
+    switch (TWI_SR_READ() & 0xf8)
+    {
+    case 0x08:  // START transmitted
+        if (twi_phase == TWI_PHASE_READ)
+            TWI_DR_WRITE((xfer->addr<<1) | TWI_READ);
+        else
+            TWI_DR_WRITE((xfer->addr<<1) | TWI_WRITE);
+        TWI_CR_WRITE(TWI_CONTINUE);
+        break;
+
+    case 0x10:  // Repeated START transmitted
+        if (twi_phase != TWI_PHASE_READ)
+        {
+            twi_engine_finish(TWI_XFER_ERROR);
+            break;
+        }
+        TWI_DR_WRITE((xfer->addr<<1) | TWI_READ);
+        TWI_CR_WRITE(TWI_CONTINUE);
+        break;
+
+    case 0x18:  // SLA+W transmitted, ACK received
+    case 0x28:  // Data byte transmitted, ACK received
+        if (twi_phase == TWI_PHASE_READ)
+        {
+            twi_engine_finish(TWI_XFER_ERROR);
+        }
+        else if (twi_phase == TWI_PHASE_MEMADDR)
+        {
+            twi_phase = TWI_PHASE_WRITE;
+            TWI_DR_WRITE(xfer->memaddr);
+            TWI_CR_WRITE(TWI_CONTINUE);
+        }
+        else if (twi_engine_next_byte(xfer) == 0)
+        {
+            TWI_CR_WRITE(TWI_CONTINUE);
+        }
+        else if (xfer->rlen != 0)
+        {
+            // Switch to read mode without releasing the bus
+            twi_phase = TWI_PHASE_READ;
+            TWI_CR_WRITE(TWI_CONTINUE | (1<<TWSTA));
+        }
+        else
+        {
+            twi_engine_finish(TWI_XFER_DONE);
+        }
+        break;
+
+    case 0x40:  // SLA+R transmitted, ACK received
+        if (twi_phase != TWI_PHASE_READ)
+        {
+            twi_engine_finish(TWI_XFER_ERROR);
+            break;
+        }
+        // ACK every byte except the last one
+        if (xfer->rlen > 1)
+            TWI_CR_WRITE(TWI_CONTINUE | (1<<TWEA));
+        else
+            TWI_CR_WRITE(TWI_CONTINUE);
+        break;
+
+    case 0x50:  // Data byte received, ACK returned
+        if (twi_phase != TWI_PHASE_READ || twi_idx >= xfer->rlen - 1)
+        {
+            twi_engine_finish(TWI_XFER_ERROR);
+            break;
+        }
+        xfer->rbuf[twi_idx++] = TWI_DR_READ();
+        if (twi_idx < xfer->rlen - 1)
+            TWI_CR_WRITE(TWI_CONTINUE | (1<<TWEA));
+        else
+            TWI_CR_WRITE(TWI_CONTINUE);
+        break;
+
+    case 0x58:  // Data byte received, NACK returned (last byte)
+        if (twi_phase != TWI_PHASE_READ || twi_idx != xfer->rlen - 1)
+        {
+            twi_engine_finish(TWI_XFER_ERROR);
+            break;
+        }
+        xfer->rbuf[twi_idx] = TWI_DR_READ();
+        twi_engine_finish(TWI_XFER_DONE);
+        break;
+
+    default:    // 0x20/0x30/0x48 NACK, 0x38 arbitration lost, 0x00 bus error
+        twi_engine_finish(TWI_XFER_ERROR);
+        break;
+    }
+}
+
+
+/*
+ * Function: twi_poll()
+ * Purpose:  One iteration of a blocking wait. Advances the engine by
+ *           hand when the TWI interrupt cannot be serviced because global
+ *           interrupts are disabled, and recovers the bus when no bus
+ *           event happened for TWI_TIMEOUT_US.
+ * Input:    watch - progress state of the calling wait loop
+ */
+static void twi_poll(twi_watch_t *watch)
+{
+    if (!(SREG & (1<<SREG_I)) && (TWI_CR_READ() & (1<<TWINT)))
+        twi_engine_step();
+
+    _delay_us(TWI_POLL_US);
+
+    if (twi_cur == NULL || twi_events != watch->events)
+    {
+        watch->events = twi_events;
+        watch->idle_us = 0;
+    }
+    else if ((watch->idle_us += TWI_POLL_US) >= TWI_TIMEOUT_US)
+    {
+        twi_recover();
+        watch->idle_us = 0;
+    }
+}
 
 
 // -- Functions --------------------------------------------
@@ -22,14 +474,272 @@ void twi_init(void)
 {
     /* Enable internal pull-up resistors on SDA and SCL lines.
        This ensures the I2C bus stays in an idle HIGH state when not driven. */
-    DDR(TWI_PORT) &= ~((1<<TWI_SDA_PIN) | (1<<TWI_SCL_PIN));  // Set SDA & SCL as inputs
-    TWI_PORT |= (1<<TWI_SDA_PIN) | (1<<TWI_SCL_PIN);          // Enable pull-ups
+    TWI_LINE_HIGH(TWI_SDA_PIN);  // Set SDA & SCL as inputs with pull-ups
+    TWI_LINE_HIGH(TWI_SCL_PIN);
 
     /* Set SCL frequency:
        Formula: SCL_freq = F_CPU / (16 + 2*TWBR*Prescaler)
        Here we clear prescaler bits and set TWBR based on desired speed. */
-    TWSR &= ~((1<<TWPS1) | (1<<TWPS0));   // Prescaler = 1
-    TWBR = TWI_BIT_RATE_REG;               // Set bit rate register
+    TWI_SR_WRITE(TWI_SR_READ() & ~((1<<TWPS1) | (1<<TWPS0)));  // Prescaler = 1
+    TWI_BR_WRITE(twi_twbr);                       // Set bit rate register
+}
+
+
+/*
+ * Function: twi_set_speed()
+ * Purpose:  Change the default SCL frequency.
+ * Input:    scl_hz - SCL frequency in Hz
+ */
+void twi_set_speed(uint32_t scl_hz)
+{
+    uint8_t twbr = twi_bit_rate(scl_hz);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        twi_twbr = twbr;
+        if (twi_cur == NULL)
+            TWI_BR_WRITE(twbr);
+    }
+}
+
+
+/*
+ * Function: twi_set_device_speed()
+ * Purpose:  Assign an SCL frequency to one slave address.
+ * Input:    addr   - 7-bit I2C slave address
+ *           scl_hz - SCL frequency in Hz, 0 to use the default
+ * Returns:  0 on success, 1 if no table entry is free
+ */
+uint8_t twi_set_device_speed(uint8_t addr, uint32_t scl_hz)
+{
+    uint8_t twbr = (scl_hz != 0) ? twi_bit_rate(scl_hz) : 0;
+    uint8_t full = 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        uint8_t slot = twi_device_slot(addr, twbr != 0);
+
+        if (slot < TWI_MAX_DEVICES)
+            twi_devices[slot].twbr = twbr;
+        else
+            full = (twbr != 0);
+    }
+    return full;
+}
+
+
+/*
+ * Function: twi_get_device_stats()
+ * Purpose:  Take a copy of the statistics of one slave address.
+ * Input:    addr  - 7-bit I2C slave address
+ *           stats - destination structure
+ * Returns:  0 on success, 1 if the address has not been used yet
+ */
+uint8_t twi_get_device_stats(uint8_t addr, twi_dev_stats_t *stats)
+{
+    uint8_t unknown = 1;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        uint8_t slot = twi_device_slot(addr, 0);
+
+        if (slot < TWI_MAX_DEVICES)
+        {
+            *stats = twi_devices[slot].stats;
+            unknown = 0;
+        }
+    }
+    return unknown;
+}
+
+
+/*
+ * Function: twi_recover()
+ * Purpose:  Free a stuck bus: clock out 9 SCL pulses so that a slave
+ *           holding SDA low finishes its byte, generate STOP and
+ *           re-initialize the TWI unit. The transaction on the bus is
+ *           aborted with an error and the queue is restarted.
+ */
+void twi_recover(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        twi_xfer_t *xfer = twi_cur;
+        uint8_t dev = twi_dev;
+
+        TWI_CR_WRITE(0);                         // Disconnect TWI from the pins
+        TWI_LINE_HIGH(TWI_SDA_PIN);
+        for (uint8_t i = 0; i < 9; i++)
+        {
+            TWI_LINE_LOW(TWI_SCL_PIN);
+            _delay_us(5);
+            TWI_LINE_HIGH(TWI_SCL_PIN);
+            _delay_us(5);
+        }
+
+        /* STOP: SDA rises while SCL is high */
+        TWI_LINE_LOW(TWI_SDA_PIN);
+        _delay_us(5);
+        TWI_LINE_HIGH(TWI_SDA_PIN);
+        _delay_us(5);
+
+        twi_init();
+        twi_stats.recoveries++;
+
+        if (xfer != NULL)
+        {
+            twi_cur = NULL;
+            if (dev < TWI_MAX_DEVICES)
+                twi_devices[dev].stats.timeouts++;
+            twi_engine_report(xfer, dev, TWI_XFER_ERROR);
+        }
+
+        /* Continue with waiting transactions (callback may have started one) */
+        if (twi_cur == NULL && (xfer = twi_dequeue()) != NULL)
+        {
+            twi_engine_load(xfer);
+            TWI_CR_WRITE(TWI_CONTINUE | (1<<TWSTA));
+        }
+    }
+}
+
+
+/*
+ * Function: twi_watchdog()
+ * Purpose:  Recover the bus if the running transaction made no progress
+ *           since the previous call. Call periodically (every 10 ms or
+ *           slower) when transactions are submitted without waiting.
+ */
+void twi_watchdog(void)
+{
+    static uint16_t last_events;
+    static uint8_t armed;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (twi_cur != NULL && armed && twi_events == last_events)
+            twi_recover();
+        armed = (twi_cur != NULL);
+        last_events = twi_events;
+    }
+}
+
+
+/*
+ * Function: twi_submit()
+ * Purpose:  Start the transaction described by xfer, or queue it behind
+ *           the one currently on the bus.
+ * Input:    xfer - transaction descriptor (owned by caller)
+ * Returns:  0 if started or queued, 1 if the queue is full
+ */
+uint8_t twi_submit(twi_xfer_t *xfer)
+{
+    uint8_t full = 0;
+    uint8_t p = (xfer->prio < TWI_PRIO_LEVELS) ? xfer->prio : TWI_PRIO_LOW;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        xfer->prio = p;
+        xfer->queued_at = systime_us();
+        xfer->retries = 0;
+
+        if (twi_cur == NULL)
+        {
+            xfer->status = TWI_XFER_PENDING;
+            twi_engine_load(xfer);
+
+            /* A STOP issued by the previous transaction may still be on the bus */
+            twi_wait_stop();
+            TWI_CR_WRITE(TWI_CONTINUE | (1<<TWSTA));
+        }
+        else if (((twi_head[p] + 1) & TWI_QUEUE_MASK) != twi_tail[p])
+        {
+            xfer->status = TWI_XFER_PENDING;
+            twi_queue[p][twi_head[p]] = xfer;
+            twi_head[p] = (twi_head[p] + 1) & TWI_QUEUE_MASK;
+            if (++twi_stats.depth > twi_stats.max_depth)
+                twi_stats.max_depth = twi_stats.depth;
+        }
+        else
+        {
+            twi_stats.rejected++;
+            full = 1;
+        }
+    }
+    return full;
+}
+
+
+/*
+ * Function: twi_busy()
+ * Returns:  1 if a transaction owns the bus, 0 otherwise
+ */
+uint8_t twi_busy(void)
+{
+    return twi_cur != NULL;
+}
+
+
+/*
+ * Function: twi_xfer_wait()
+ * Purpose:  Block until the given transaction has finished.
+ * Input:    xfer - submitted transaction descriptor
+ * Returns:  TWI_XFER_DONE or TWI_XFER_ERROR
+ */
+uint8_t twi_xfer_wait(twi_xfer_t *xfer)
+{
+    twi_watch_t watch = { twi_events, 0 };
+
+    while (xfer->status == TWI_XFER_PENDING)
+        twi_poll(&watch);
+
+    return xfer->status;
+}
+
+
+/*
+ * Function: twi_transfer()
+ * Purpose:  Submit a transaction, waiting for a queue slot if necessary,
+ *           and block until it completes.
+ * Returns:  0 on success, 1 on error
+ */
+uint8_t twi_transfer(twi_xfer_t *xfer)
+{
+    twi_watch_t watch = { twi_events, 0 };
+
+    while (twi_submit(xfer))
+        twi_poll(&watch);
+
+    return twi_xfer_wait(xfer) != TWI_XFER_DONE;
+}
+
+
+/*
+ * Function: twi_get_stats()
+ * Purpose:  Take a consistent copy of the queue statistics.
+ */
+void twi_get_stats(twi_stats_t *stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        *stats = twi_stats;
+    }
+}
+
+
+/*
+ * Function: twi_reset_stats()
+ * Purpose:  Clear counters and maxima, keep the current queue depth.
+ */
+void twi_reset_stats(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        uint8_t depth = twi_stats.depth;
+        twi_stats = (twi_stats_t){ .depth = depth, .max_depth = depth };
+        for (uint8_t i = 0; i < TWI_MAX_DEVICES; i++)
+            twi_devices[i].stats = (twi_dev_stats_t){ 0 };
+    }
 }
 
 
@@ -37,16 +747,22 @@ void twi_init(void)
  * Function: twi_start()
  * Purpose:  Generate a START condition on the I2C bus.
  *           Used to signal the beginning of a communication sequence.
+ * Returns:  0 on success, 1 if the bus did not respond in time
  */
-void twi_start(void)
+uint8_t twi_start(void)
 {
     /* TWINT = 1: clear interrupt flag
        TWSTA = 1: send START condition
        TWEN  = 1: enable TWI */
-    TWCR = (1<<TWINT) | (1<<TWSTA) | (1<<TWEN);
+    TWI_CR_WRITE((1<<TWINT) | (1<<TWSTA) | (1<<TWEN));
 
     /* Wait until the START condition has been transmitted */
-    while ((TWCR & (1<<TWINT)) == 0);
+    if (twi_wait_int())
+    {
+        twi_recover();
+        return 1;
+    }
+    return 0;
 }
 
 
@@ -62,16 +778,20 @@ uint8_t twi_write(uint8_t data)
     uint8_t twi_status;
 
     /* Load data (address or data byte) into the data register */
-    TWDR = data;
+    TWI_DR_WRITE(data);
 
     /* Start transmission */
-    TWCR = (1<<TWINT) | (1<<TWEN);
+    TWI_CR_WRITE((1<<TWINT) | (1<<TWEN));
 
     /* Wait until transmission completes */
-    while ((TWCR & (1<<TWINT)) == 0);
+    if (twi_wait_int())
+    {
+        twi_recover();
+        return 1;   // Treat a timeout like NACK
+    }
 
     /* Mask prescaler bits to read TWI status code (upper 5 bits only) */
-    twi_status = TWSR & 0xf8;
+    twi_status = TWI_SR_READ() & 0xf8;
 
     /* Check if ACK was received:
          0x18 = SLA+W transmitted, ACK received
@@ -94,15 +814,19 @@ uint8_t twi_read(uint8_t ack)
 {
     if (ack == TWI_ACK)
         // Send ACK after receiving the byte (want to continue reading)
-        TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWEA);
+        TWI_CR_WRITE((1<<TWINT) | (1<<TWEN) | (1<<TWEA));
     else
         // Send NACK after receiving the byte (last byte)
-        TWCR = (1<<TWINT) | (1<<TWEN);
+        TWI_CR_WRITE((1<<TWINT) | (1<<TWEN));
 
     // Wait for reception to complete
-    while ((TWCR & (1<<TWINT)) == 0);
+    if (twi_wait_int())
+    {
+        twi_recover();
+        return 0xff;    // Idle bus level
+    }
 
-    return (TWDR);  // Return received byte
+    return TWI_DR_READ();  // Return received byte
 }
 
 
@@ -116,7 +840,7 @@ void twi_stop(void)
     /* TWSTO = 1: send STOP
        TWINT = 1: clear interrupt flag
        TWEN  = 1: keep TWI enabled */
-    TWCR = (1<<TWINT) | (1<<TWSTO) | (1<<TWEN);
+    TWI_CR_WRITE((1<<TWINT) | (1<<TWSTO) | (1<<TWEN));
 }
 
 
@@ -129,13 +853,12 @@ void twi_stop(void)
  */
 uint8_t twi_test_address(uint8_t addr)
 {
-    uint8_t ack;  // Holds the ACK result
+    twi_xfer_t xfer = {
+        .addr = addr,   // SLA+W only, no data
+        .flags = TWI_XFER_NORETRY,
+    };
 
-    twi_start();                            // Begin communication
-    ack = twi_write((addr<<1) | TWI_WRITE); // Send SLA+W (address + write bit)
-    twi_stop();                             // Stop communication
-
-    return ack;
+    return twi_transfer(&xfer);
 }
 
 
@@ -146,37 +869,92 @@ uint8_t twi_test_address(uint8_t addr)
  *           memaddr - internal memory/register address to start from
  *           buf     - pointer to buffer to store received bytes
  *           nbytes  - number of bytes to read
- * Returns:  none
+ * Returns:  0 on success, 1 if the device did not respond
  */
-void twi_readfrom_mem_into(uint8_t addr, uint8_t memaddr, volatile uint8_t *buf, uint8_t nbytes)
+uint8_t twi_readfrom_mem_into(uint8_t addr, uint8_t memaddr, volatile uint8_t *buf, uint8_t nbytes)
 {
-    twi_start();
-    if (twi_write((addr<<1) | TWI_WRITE) == 0)  // Send slave address with Write
-    {
-        // Tell slave which internal memory/register address we want to read from
-        twi_write(memaddr);
-        twi_stop();
+    twi_xfer_t xfer = {
+        .addr = addr,
+        .flags = TWI_XFER_MEMADDR,
+        .memaddr = memaddr,   // Register to start reading from
+        .rbuf = buf,
+        .rlen = nbytes,
+    };
 
-        // Generate a repeated start to switch from write mode to read mode
-        twi_start();
-        twi_write((addr<<1) | TWI_READ);  // Send slave address with Read
+    return twi_transfer(&xfer);
+}
 
-        // If reading multiple bytes, ACK each except the last
-        if (nbytes >= 2)
-        {
-            for (uint8_t i = 0; i < (nbytes - 1); i++)
-            {
-                *buf++ = twi_read(TWI_ACK);  // Read byte and acknowledge
-            }
-        }
 
-        // Read last byte and send NACK to signal end of transmission
-        *buf = twi_read(TWI_NACK);
-        twi_stop();
-    }
-    else
-    {
-        // If device didn't acknowledge, end communication
-        twi_stop();
-    }
+/*
+ * Function: twi_write_read()
+ * Purpose:  Write bytes, then read the answer after a repeated START.
+ * Input:    addr - 7-bit I2C slave address
+ *           wbuf - bytes to transmit, wlen - their count
+ *           rbuf - buffer for received bytes, rlen - their count
+ * Returns:  0 on success, 1 on error
+ */
+uint8_t twi_write_read(uint8_t addr, const uint8_t *wbuf, uint8_t wlen, volatile uint8_t *rbuf, uint8_t rlen)
+{
+    twi_xfer_t xfer = {
+        .addr = addr,
+        .wbuf = wbuf,
+        .wlen = wlen,
+        .rbuf = rbuf,
+        .rlen = rlen,
+    };
+
+    return twi_transfer(&xfer);
+}
+
+
+/*
+ * Function: twi_writev()
+ * Purpose:  Send several buffers in one write transaction.
+ * Input:    addr   - 7-bit I2C slave address
+ *           iov    - array of segments
+ *           iovcnt - number of segments
+ * Returns:  0 on success, 1 on error
+ */
+uint8_t twi_writev(uint8_t addr, const twi_iov_t *iov, uint8_t iovcnt)
+{
+    twi_xfer_t xfer = {
+        .addr = addr,
+        .wiov = iov,
+        .wiovcnt = iovcnt,
+    };
+
+    return twi_transfer(&xfer);
+}
+
+
+/*
+ * Function: twi_writeto_mem()
+ * Purpose:  Write multiple bytes after a memory address or control byte.
+ * Input:    addr    - 7-bit I2C slave address
+ *           memaddr - memory/register address or control byte
+ *           buf     - bytes to transmit
+ *           nbytes  - number of bytes to transmit
+ * Returns:  0 on success, 1 if the device did not respond
+ */
+uint8_t twi_writeto_mem(uint8_t addr, uint8_t memaddr, const uint8_t *buf, uint16_t nbytes)
+{
+    twi_xfer_t xfer = {
+        .addr = addr,
+        .flags = TWI_XFER_MEMADDR,
+        .memaddr = memaddr,
+        .wbuf = buf,
+        .wlen = nbytes,
+    };
+
+    return twi_transfer(&xfer);
+}
+
+
+/*
+ * Function: ISR(TWI_vect)
+ * Purpose:  TWI bus event finished; continue the running transaction.
+ */
+ISR(TWI_vect)
+{
+    twi_engine_step();
 }
@@ -24,6 +24,17 @@
  * Only master modes (transmit/receive) are implemented. It relies on
  * the AVR’s internal TWI hardware registers.
  *
+ * Two interfaces are provided:
+ *  - an interrupt-driven transaction engine (twi_submit()), where the
+ *    caller hands over a ::twi_xfer_t descriptor and returns immediately
+ *    while ISR(TWI_vect) moves the bytes,
+ *  - blocking helpers (twi_readfrom_mem_into(), twi_writeto_mem(),
+ *    twi_test_address()), which are thin wrappers around the engine.
+ *
+ * The byte-level primitives twi_start(), twi_write(), twi_read() and
+ * twi_stop() poll the hardware directly and must not be mixed with
+ * transactions that are still in progress.
+ *
  * @note Based on the Microchip (Atmel) ATmega16/ATmega328P datasheets.
  */
 
@@ -51,6 +62,37 @@
  */
 #define TWI_BIT_RATE_REG ((F_CPU/F_SCL - 16) / 2)
 
+/**
+ * @name Runtime bus speeds for twi_set_speed() / twi_set_device_speed()
+ *
+ * Calculated payload throughput (9 SCL periods per byte plus about 5 µs
+ * of interrupt handling per byte at 16 MHz), e.g. for a full SH1106
+ * refresh of 8 pages × (5 command + 128 data bytes + 4 framing bytes);
+ * the "twi" UART command of the application measures it on the board:
+ *
+ *  | SCL     | bytes/s | full oled_display() |
+ *  |---------|---------|---------------------|
+ *  | 100 kHz | ~10 500 | ~104 ms             |
+ *  | 400 kHz | ~36 400 | ~30 ms              |
+ */
+#define TWI_SPEED_STANDARD 100000UL /**< Standard mode, 100 kHz */
+#define TWI_SPEED_FAST     400000UL /**< Fast mode, 400 kHz */
+
+#ifndef TWI_MAX_DEVICES
+# define TWI_MAX_DEVICES 4 /**< Slave addresses with own bus speed and statistics */
+#endif
+
+/**
+ * @name Timeouts and retries
+ */
+#ifndef TWI_TIMEOUT_US
+# define TWI_TIMEOUT_US 5000 /**< Longest time without any bus event before
+                                  the bus is considered stuck */
+#endif
+#ifndef TWI_RETRIES
+# define TWI_RETRIES 2       /**< Repetitions of a failed transaction */
+#endif
+
 
 // -----------------------------------------------------------------------------
 //  Port and pin configuration for SDA and SCL lines
@@ -76,6 +118,31 @@
 #define TWI_ACK 0   /**< Send ACK after reading (means “continue reading”) */
 #define TWI_NACK 1  /**< Send NACK after reading (means “stop reading”) */
 
+/**
+ * @name Transaction status codes (twi_xfer_t::status)
+ */
+#define TWI_XFER_IDLE    0 /**< Descriptor not submitted yet */
+#define TWI_XFER_PENDING 1 /**< Submitted, waiting for or using the bus */
+#define TWI_XFER_DONE    2 /**< Completed successfully */
+#define TWI_XFER_ERROR   3 /**< Aborted (NACK, arbitration lost, bus error) */
+
+/**
+ * @name Transaction priorities (twi_xfer_t::prio)
+ */
+#define TWI_PRIO_HIGH 0 /**< Sensor reads; overtake queued low-priority traffic */
+#define TWI_PRIO_LOW  1 /**< Bulk display writes */
+#define TWI_PRIO_LEVELS 2
+
+#ifndef TWI_QUEUE_SIZE
+# define TWI_QUEUE_SIZE 4 /**< Queue ring size per priority level (power of 2, holds size-1) */
+#endif
+
+/**
+ * @name Transaction flags (twi_xfer_t::flags)
+ */
+#define TWI_XFER_MEMADDR 0x01 /**< Send twi_xfer_t::memaddr right after SLA+W */
+#define TWI_XFER_NORETRY 0x02 /**< Report the first error, do not retry */
+
 /**
  * AVR trick macros: convert a PORT register name to its corresponding
  * Data Direction (DDR) and PIN registers.
@@ -92,6 +159,89 @@
 #define PIN(_x) (*(&_x - 2))
 
 
+// -----------------------------------------------------------------------------
+//  Transaction descriptor
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief One segment of a gathered (vectored) write.
+ */
+typedef struct {
+    const uint8_t *buf;         /**< Segment data */
+    uint16_t len;               /**< Segment length in bytes */
+} twi_iov_t;
+
+/**
+ * @brief Description of one master transaction on the bus.
+ *
+ * The engine sends START + SLA+W, the optional memory/register address
+ * (or control byte), then @c wlen bytes from @c wbuf followed by the
+ * @c wiovcnt segments of @c wiov, all in one transaction. If @c rlen is
+ * non-zero it continues with a repeated START + SLA+R and reads @c rlen
+ * bytes into @c rbuf. A transaction with neither write nor read data
+ * only probes the address.
+ *
+ * The descriptor and both buffers are owned by the caller and must stay
+ * valid until @c status leaves ::TWI_XFER_PENDING.
+ *
+ * Transactions submitted while the bus is busy wait in a static queue.
+ * The queue is served in priority order, FIFO within one level, and a
+ * running transaction is never interrupted; high-priority sensor reads
+ * therefore wait at most for the one display transfer (page) in flight.
+ */
+typedef struct twi_xfer {
+    uint8_t addr;               /**< 7-bit slave address */
+    uint8_t prio;               /**< TWI_PRIO_HIGH (default) or TWI_PRIO_LOW */
+    uint8_t flags;              /**< Combination of TWI_XFER_* flags */
+    uint8_t memaddr;            /**< Register address / control byte */
+    const uint8_t *wbuf;        /**< Bytes to transmit (may be NULL) */
+    uint16_t wlen;              /**< Number of bytes in wbuf */
+    const twi_iov_t *wiov;      /**< Further segments sent after wbuf (may be NULL) */
+    uint8_t wiovcnt;            /**< Number of segments in wiov */
+    volatile uint8_t *rbuf;     /**< Buffer for received bytes (may be NULL) */
+    uint8_t rlen;               /**< Number of bytes to receive */
+    volatile uint8_t status;    /**< One of TWI_XFER_* status codes */
+    void (*callback)(struct twi_xfer *xfer); /**< Called from the TWI
+                                     interrupt when finished (may be NULL) */
+    uint32_t queued_at;         /**< Internal: systime_us() at submission */
+    uint8_t retries;            /**< Internal: retries used so far */
+} twi_xfer_t;
+
+
+/**
+ * @brief Queue statistics.
+ *
+ * Wait times are in µs (systime_us()), so they compare across devices
+ * running at different bus speeds. The sums wrap after 71 minutes of
+ * waiting in total; clear them with twi_reset_stats().
+ */
+typedef struct {
+    uint8_t depth;              /**< Transactions waiting right now */
+    uint8_t max_depth;          /**< Highest depth observed */
+    uint16_t rejected;          /**< Submissions refused, queue full */
+    uint16_t completed[TWI_PRIO_LEVELS]; /**< Finished transactions per priority */
+    uint32_t max_wait[TWI_PRIO_LEVELS];  /**< Longest queue wait per priority, µs */
+    uint32_t total_wait[TWI_PRIO_LEVELS];/**< Sum of queue waits per priority, µs */
+    uint16_t recoveries;        /**< Stuck-bus recoveries */
+} twi_stats_t;
+
+
+/**
+ * @brief Statistics of one slave address.
+ *
+ * Latency is measured from submission to completion (queue wait
+ * included), in µs like the queue wait times.
+ */
+typedef struct {
+    uint16_t transfers;         /**< Finished transactions */
+    uint16_t errors;            /**< Transactions that failed after all retries */
+    uint16_t retries;           /**< Repeated attempts */
+    uint16_t timeouts;          /**< Transactions aborted by bus recovery */
+    uint32_t max_latency;       /**< Longest latency, µs */
+    uint32_t total_latency;     /**< Sum of latencies, µs */
+} twi_dev_stats_t;
+
+
 // -----------------------------------------------------------------------------
 //  Function prototypes
 // -----------------------------------------------------------------------------
@@ -105,19 +255,138 @@
 void twi_init(void);
 
 
+/**
+ * @brief Change the default SCL frequency at runtime.
+ *
+ * Applies to all devices without an own speed set by
+ * twi_set_device_speed(). Takes effect with the next transaction.
+ *
+ * @param scl_hz  SCL frequency in Hz (about 31 kHz to 400 kHz at 16 MHz);
+ *                values outside are limited to that range, 0 gives 31 kHz.
+ */
+void twi_set_speed(uint32_t scl_hz);
+
+
+/**
+ * @brief Set the SCL frequency used for one slave address.
+ *
+ * The bit rate register is switched at the START of every transaction,
+ * so a fast device (e.g. the OLED at 400 kHz) can share the bus with a
+ * device limited to standard mode.
+ *
+ * @param addr    7-bit slave address.
+ * @param scl_hz  SCL frequency in Hz, or 0 to fall back to the default.
+ * @return 0 on success, 1 if the device table is full.
+ */
+uint8_t twi_set_device_speed(uint8_t addr, uint32_t scl_hz);
+
+
+/**
+ * @brief Start an asynchronous transaction.
+ *
+ * @param xfer  Filled-in transaction descriptor.
+ * @return 0 if the transaction was started or queued, 1 if the queue
+ *         for its priority is full.
+ *
+ * On success the descriptor status is ::TWI_XFER_PENDING and the function
+ * returns immediately; completion is signalled by the status field and
+ * the optional callback.
+ */
+uint8_t twi_submit(twi_xfer_t *xfer);
+
+
+/**
+ * @brief Submit a transaction and block until it completes.
+ *
+ * Waits for a free queue slot if necessary. Like twi_xfer_wait() it may
+ * be called with global interrupts disabled.
+ *
+ * @param xfer  Filled-in transaction descriptor.
+ * @return 0 on success, 1 on error.
+ */
+uint8_t twi_transfer(twi_xfer_t *xfer);
+
+
+/**
+ * @brief Copy the queue statistics.
+ *
+ * @param stats  Destination structure.
+ */
+void twi_get_stats(twi_stats_t *stats);
+
+
+/**
+ * @brief Copy the statistics of one slave address.
+ *
+ * @param addr   7-bit slave address.
+ * @param stats  Destination structure.
+ * @return 0 on success, 1 if the address has not been used yet.
+ */
+uint8_t twi_get_device_stats(uint8_t addr, twi_dev_stats_t *stats);
+
+
+/**
+ * @brief Clear the queue and per-device statistics (current depth is kept).
+ */
+void twi_reset_stats(void);
+
+
+/**
+ * @brief Free a stuck bus and restart the transaction queue.
+ *
+ * Clocks out 9 SCL pulses so that a slave holding SDA low can finish,
+ * generates STOP and calls twi_init(). The transaction on the bus, if
+ * any, ends with ::TWI_XFER_ERROR. Called automatically when a blocking
+ * wait sees no bus event for ::TWI_TIMEOUT_US.
+ */
+void twi_recover(void);
+
+
+/**
+ * @brief Detect a stalled transaction without blocking.
+ *
+ * Recovers the bus if the running transaction made no progress since
+ * the previous call. Call it periodically (every 10 ms or slower) when
+ * transactions are submitted without waiting for them.
+ */
+void twi_watchdog(void);
+
+
+/**
+ * @brief Check whether a transaction is in progress.
+ *
+ * @return 1 if the engine owns the bus, 0 if idle.
+ */
+uint8_t twi_busy(void);
+
+
+/**
+ * @brief Wait until a submitted transaction finishes.
+ *
+ * Safe to call with global interrupts disabled (e.g. from another ISR):
+ * in that case the engine is advanced by polling the TWINT flag.
+ *
+ * @param xfer  Previously submitted descriptor.
+ * @return ::TWI_XFER_DONE or ::TWI_XFER_ERROR.
+ */
+uint8_t twi_xfer_wait(twi_xfer_t *xfer);
+
+
 /**
  * @brief Send a START condition to begin communication.
  *
  * Places the TWI bus in a busy state and prepares to send an address byte.
+ *
+ * @return 0 on success, 1 on timeout (the bus has been recovered).
  */
-void twi_start(void);
+uint8_t twi_start(void);
 
 
 /**
  * @brief Send one byte (address or data) on the TWI bus.
  *
  * @param data  The byte to transmit.
- * @return 0 if ACK received, 1 if NACK.
+ * @return 0 if ACK received, 1 if NACK or timeout.
  *
  * @note
  * Returns 0 (ACK) if TWI status register indicates:
@@ -132,7 +401,7 @@ uint8_t twi_write(uint8_t data);
  * @brief Read one byte from the TWI bus.
  *
  * @param ack  Whether to send ACK (0) or NACK (1) after receiving the byte.
- * @return     The received byte.
+ * @return     The received byte (0xff on timeout).
  */
 uint8_t twi_read(uint8_t ack);
 
@@ -166,8 +435,77 @@ uint8_t twi_test_address(uint8_t addr);
  *   3. Send repeated START + SLA+R  
  *   4. Read N bytes (ACK for all but last, NACK for last)  
  *   5. Send STOP  
+ *
+ * @return 0 on success, 1 on error.
+ */
+uint8_t twi_readfrom_mem_into(uint8_t addr, uint8_t memaddr, volatile uint8_t *buf, uint8_t nbytes);
+
+
+/**
+ * @brief Write bytes and read the answer in one transaction.
+ *
+ * @param addr  Slave address.
+ * @param wbuf  Bytes to transmit (e.g. register address), may be NULL.
+ * @param wlen  Number of bytes to transmit.
+ * @param rbuf  Buffer for received data.
+ * @param rlen  Number of bytes to read.
+ * @return 0 on success, 1 on error.
+ *
+ * The write and read phases are joined by a repeated START, so no other
+ * master or queued transaction can access the device in between. Every
+ * status code of the sequence (0x08/0x18/0x28/0x10/0x40/0x50/0x58) is
+ * checked and any unexpected one aborts the transaction.
+ */
+uint8_t twi_write_read(uint8_t addr, const uint8_t *wbuf, uint8_t wlen, volatile uint8_t *rbuf, uint8_t rlen);
+
+
+/**
+ * @brief Write several buffers to a slave device in one transaction.
+ *
+ * Useful to send a command prefix together with a payload without
+ * copying both into one buffer first.
+ *
+ * @param addr    Slave address.
+ * @param iov     Array of segments.
+ * @param iovcnt  Number of segments.
+ * @return 0 on success, 1 on error.
  */
-void twi_readfrom_mem_into(uint8_t addr, uint8_t memaddr, volatile uint8_t *buf, uint8_t nbytes);
+uint8_t twi_writev(uint8_t addr, const twi_iov_t *iov, uint8_t iovcnt);
+
+
+/**
+ * @brief Write multiple bytes to a slave device after a memory/register address.
+ *
+ * @param addr     Slave address.
+ * @param memaddr  Memory/register address or control byte sent first.
+ * @param buf      Bytes to transmit.
+ * @param nbytes   Number of bytes to transmit.
+ * @return 0 on success, 1 on error.
+ */
+uint8_t twi_writeto_mem(uint8_t addr, uint8_t memaddr, const uint8_t *buf, uint16_t nbytes);
+
+
+// -----------------------------------------------------------------------------
+//  Host simulation
+// -----------------------------------------------------------------------------
+
+#ifdef TWI_HW_SIM
+/**
+ * @name Simulated peripheral (host builds only)
+ *
+ * With TWI_HW_SIM defined the library does not touch TWCR, TWSR, TWDR,
+ * TWBR or the SDA/SCL port bits. Every access goes to these functions,
+ * which the host test implements (test/test_twi).
+ */
+#define TWI_SIM_TWCR 0
+#define TWI_SIM_TWSR 1
+#define TWI_SIM_TWDR 2
+#define TWI_SIM_TWBR 3
+
+uint8_t twi_sim_read(uint8_t reg);              /**< Read a TWI register */
+void twi_sim_write(uint8_t reg, uint8_t value); /**< Write a TWI register */
+void twi_sim_line(uint8_t pin, uint8_t level);  /**< Drive SDA/SCL low (0) or release it (1) */
+#endif
 
 /** @} */  // End of doxygen documentation group
 
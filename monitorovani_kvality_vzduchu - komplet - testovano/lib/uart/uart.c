@@ -334,6 +334,9 @@
 # error "no UART definition for MCU available"
 #endif /* if defined(__AVR_AT90S2313__) || defined(__AVR_AT90S4414__) || defined(__AVR_AT90S8515__) || defined(__AVR_AT90S4434__) || defined(__AVR_AT90S8535__) || defined(__AVR_ATmega103__) */
 
+/* Transmit Complete flag (TXC, TXC0, TXC1): bit 6 of the status register on every USART */
+#define UART0_BIT_TXC             6
+
 
 /*
  *  module global variables
@@ -345,6 +348,7 @@ static volatile unsigned char UART_TxTail;
 static volatile unsigned char UART_RxHead;
 static volatile unsigned char UART_RxTail;
 static volatile unsigned char UART_LastRxError;
+static volatile unsigned char UART_TxStarted;   /* a byte was written to UART0_DATA */
 
 #if defined( ATMEGA_USART1 )
 static volatile unsigned char UART1_TxBuf[UART_TX_BUFFER_SIZE];
@@ -419,6 +423,9 @@ ISR(UART0_TRANSMIT_INTERRUPT)
         /* calculate and store new buffer index */
         tmptail     = (UART_TxTail + 1) & UART_TX_BUFFER_MASK;
         UART_TxTail = tmptail;
+        /* clear TXC by writing one, the USART sets it when this byte has left the shift register */
+        UART0_STATUS   = (UART0_STATUS & _BV(UART0_BIT_U2X)) | _BV(UART0_BIT_TXC);
+        UART_TxStarted = 1;
         /* get one byte from buffer and write it to UART */
         UART0_DATA = UART_TxBuf[tmptail]; /* start transmission */
     }
@@ -442,6 +449,7 @@ void uart_init(unsigned int baudrate)
     UART_TxTail = 0;
     UART_RxHead = 0;
     UART_RxTail = 0;
+    UART_TxStarted = 0;
 
     #ifdef UART_TEST
     # ifndef UART0_BIT_U2X
@@ -568,6 +576,31 @@ void uart_puts_p(const char *progmem_s)
         uart_putc(c);
 }/* uart_puts_p */
 
+/*************************************************************************
+ * Function: uart_tx_busy()
+ * Purpose:  check whether characters are still waiting to be sent
+ * Input:    none
+ * Returns:  nonzero while the ringbuffer holds data, UDRE interrupt is on
+ *           or the last byte written to UART0_DATA has not been shifted
+ *           out yet (TXC still clear)
+ **************************************************************************/
+unsigned char uart_tx_busy(void)
+{
+    return (UART_TxHead != UART_TxTail) || (UART0_CONTROL & _BV(UART0_UDRIE)) ||
+           (UART_TxStarted && !(UART0_STATUS & _BV(UART0_BIT_TXC)));
+}/* uart_tx_busy */
+
+/*************************************************************************
+ * Function: uart_rx_ready()
+ * Purpose:  check whether received characters wait in the ringbuffer
+ * Input:    none
+ * Returns:  nonzero if uart_getc() has data
+ **************************************************************************/
+unsigned char uart_rx_ready(void)
+{
+    return UART_RxHead != UART_RxTail;
+}/* uart_rx_ready */
+
 /*
  * these functions are only for ATmegas with two USART
  */
@@ -155,6 +155,23 @@ extern void uart_puts_p(const char *s);
  */
 #define uart_puts_P(__s) uart_puts_p(PSTR(__s))
 
+/**
+ * @brief Check whether the transmitter still has work queued.
+ *
+ * @return Nonzero while characters wait in the transmit buffer, or
+ *         until the last one has left the shift register (TXC set,
+ *         one frame time after the buffer empties: 87 µs at 115200 Bd).
+ */
+extern unsigned char uart_tx_busy(void);
+
+
+/**
+ * @brief Check whether received characters wait in the buffer.
+ *
+ * @return Nonzero if uart_getc() would return a character.
+ */
+extern unsigned char uart_rx_ready(void);
+
 
 // -----------------------------------------------------------------------------
 //  Secondary UART (USART1) – for MCUs with multiple UARTs (e.g. ATmega128)
@@ -2,40 +2,96 @@
 // Basic AVR libraries
 #include <avr/io.h>         // Definitions of registers, ports and bits for AVR
 #include <avr/interrupt.h>  // Macros for enabling/disabling interrupts
+#include <avr/sleep.h>      // Idle sleep between tasks
+#include <avr/eeprom.h>     // Sampling periods across resets
+#include <util/crc16.h>     // CRC of the EEPROM record
+#include <stddef.h>         // offsetof
 #include "timer.h"          // Custom library for timer configuration
 #include <twi.h>            // I2C (TWI) communication
 #include <uart.h>           // UART communication (Peter Fleury)
-#include <stdio.h>          // sprintf and snprintf for formatted text
+#include <fmt.h>            // Number formatting for OLED and UART
+#include <adc.h>            // Shared ADC channel service
+#include <mq135.h>          // MQ135 Rs and CO2 ppm in fixed point
+#include <dht12.h>          // DHT12 temperature and humidity
+#include <systime.h>        // 1 ms time base, reading timestamps
+#include <sched.h>          // Cooperative task scheduler
 #include <oled.h>           // OLED display library
 #include "gp2y1010.h"       // Sharp GP2Y1010 dust sensor library
 
 // -- Defines --------------------------------------------------------
-// I2C address of DHT12 sensor
-#define DHT_ADR      0x5c
-#define DHT_HUM_MEM  0      // Memory address for humidity
-#define DHT_TEMP_MEM 2      // Memory address for temperature
+// Convert MQ135 with the CPU in ADC Noise Reduction sleep (1) or in a
+// free slot after a dust sample (0)
+#define MQ135_QUIET  1
 
-// -- Global variables -----------------------------------------------
-// Flag indicating that UART data needs to be updated
-volatile uint8_t flag_update_uart = 0;
+// Task periods in 1 ms ticks (Timer2 in CTC mode, exact)
+#define TICKS_1S     1000
+#define TICKS_5S     (5 * TICKS_1S)
+
+// Task table indices, highest priority first
+enum { TASK_SECOND, TASK_MQ135, TASK_DUST, TASK_CLIMATE, TASK_DISPLAY,
+       TASK_REPORT, TASK_COUNT };
 
-// Flag indicating that OLED display needs to be updated
-volatile uint8_t flag_update_oled = 0;
+// Sensors with a sampling period set by "rate", ms
+enum { RATE_MQ135, RATE_DUST, RATE_DHT12, RATE_COUNT };
+#define RATE_MAX_MS  60000
+#define RATES_MAGIC  0x5052
 
-// Array for storing DHT12 sensor values
-volatile uint8_t dht12_values[5]; 
-// [0] = humidity integer, [1] = humidity decimal
-// [2] = temperature integer, [3] = temperature decimal
-// [4] = checksum
+// -- Global variables -----------------------------------------------
+// Last valid DHT12 reading; 20.0 C / 33.0 % (no MQ135 compensation)
+// until the first one
+dht12_sample_t climate = { .temp = 200, .hum = 330 };
+uint8_t climate_valid = 0;
 
 // MQ135 sensor values
-volatile uint16_t mq135_value = 0;    // Raw ADC value
+uint16_t mq135_value = 0;             // Raw ADC value
+int8_t mq135_adc = -1;                // Channel id in the ADC service
+int8_t noise_adc = -1;                // ADC0 in the other kind of slot, for "noise"
+uint16_t mq135_co2 = 0;               // CO2 equivalent in ppm, T/RH compensated
+uint32_t mq135_ms = 0;                // systime_ms() of the raw value
+uint32_t mq135_warm_ms = 0;           // Warm-up detection fed up to here
+
+// Time spent in idle sleep since duty_since (systime_ms()): whole ms,
+// and scheduler clock counts (4 us) not yet moved into them. In ms the
+// window wraps after 49.7 days, in counts it would after 4.8 h
+uint32_t sleep_ms = 0;
+uint32_t sleep_counts = 0;
+uint32_t duty_since = 0;
+
+// UART command line ("cal [time]", "rate dht12 60000")
+char cmd_line[24];
+uint8_t cmd_len = 0;
 
 
 // GP2Y1010 dust sensor values
-volatile uint16_t dust_raw = 0;       // Raw ADC value
-volatile float dust_voltage = 0;      // Converted voltage
-volatile float dust_density = 0;      // Converted dust density in ug/m3
+uint16_t dust_raw = 0;                // Filtered ADC value, counts x 16
+uint16_t dust_mv = 0;                 // Converted voltage in mV
+uint16_t dust_density = 0;            // Converted dust density in 0.1 ug/m3
+uint32_t dust_ms = 0;                 // systime_ms() at the end of its window
+
+// Sensor pipelines with their own period; the display and the report
+// only take the latest values. The DHT12 needs 2 s between measurements
+typedef struct {
+    const char *name;                 // For "rate"
+    uint8_t task;                     // TASK_* index
+    uint16_t def_ms;                  // Period without a valid EEPROM record
+    uint16_t min_ms;
+} rate_cfg_t;
+
+const rate_cfg_t rate_cfg[RATE_COUNT] = {
+    [RATE_MQ135] = { "mq135", TASK_MQ135,   1000,  100 },
+    [RATE_DUST]  = { "dust",  TASK_DUST,    1000,  100 },
+    [RATE_DHT12] = { "dht12", TASK_CLIMATE, 10000, 2000 },
+};
+uint16_t rate_ms[RATE_COUNT];         // Periods in use
+
+// EEPROM record of the periods, checked by magic and CRC before use
+typedef struct {
+    uint16_t magic;
+    uint16_t ms[RATE_COUNT];
+    uint16_t crc;
+} rates_t;
+
+rates_t EEMEM ee_rates;
 
 // GP2Y1010 sensor configuration structure
 GP2Y1010 dust = {
@@ -56,7 +112,7 @@ void oled_setup(void)
 
     // Labels for each measurement
     oled_gotoxy(0, 2);
-    oled_puts("MQ135 ADC:");
+    oled_puts("CO2 [ppm]:");
     oled_gotoxy(0, 3);
     oled_puts("Level:");
     oled_gotoxy(0, 4);
@@ -71,182 +127,639 @@ void oled_setup(void)
 
 
 // -------- ADC INITIALIZATION for MQ135 ---------
-//void mq135_adc_init(void)
-//{
-//     Set ADC reference voltage to AVcc (5V)
-//    ADMUX = (1 << REFS0);
-//
-//     Enable ADC and set prescaler to 128 (16 MHz / 128 = 125 kHz)
-//    ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
-//}
+void mq135_adc_init(void)
+{
+    // Channel 0 (A0)
+#if MQ135_QUIET
+    mq135_adc = adc_register(0, ADC_QUIET, NULL, NULL);
+    noise_adc = adc_register(0, 0, NULL, NULL);
+#else
+    mq135_adc = adc_register(0, 0, NULL, NULL);
+    noise_adc = adc_register(0, ADC_QUIET, NULL, NULL);
+#endif
+    adc_request(mq135_adc);     // First value ready for task_mq135()
+}
 
-// -------- ADC READ for MQ135 ---------
-uint16_t mq135_read(void)
+// Noise Reduction sleep stops clkI/O: no I2C or UART transfer may be
+// running and no dust LED pulse may be stretched. The receiver stops
+// too, so nothing may be arriving: no command line half typed and RXD
+// (PD0) idle high, not in a start bit
+uint8_t adc_quiet_ready(void)
 {
-    // Select ADC channel 0 (A0)
-    ADMUX = (ADMUX & 0xF0) | 0;  // 0 = ADC0
+    return !twi_busy() && !uart_tx_busy() && gp2y1010_quiet() &&
+           cmd_len == 0 && (PIND & (1 << PD0));
+}
+
 
-    // Start conversion
-    ADCSRA |= (1 << ADSC);
+// Decimal number at s, the last word of a command line; 0 and *value
+// unchanged when there is none, something follows it or it is above max
+uint8_t parse_uint(const char *s, uint32_t max, uint32_t *value)
+{
+    uint32_t v = 0;
+    uint8_t digit;
+
+    while (*s == ' ')
+        s++;
+    if (*s < '0' || *s > '9')
+        return 0;
+    while (*s >= '0' && *s <= '9')
+    {
+        digit = *s++ - '0';
+        if (v > (max - digit) / 10)
+            return 0;       // Above max, also before a 32-bit wrap
+        v = v * 10 + digit;
+    }
+    while (*s == ' ')
+        s++;
+    if (*s != '\0')
+        return 0;
+    *value = v;
+    return 1;
+}
 
-    // Wait until conversion is complete
-    while (ADCSRA & (1 << ADSC));
+// CRC-CCITT of a periods record without its crc field
+uint16_t rates_crc(const rates_t *rec)
+{
+    const uint8_t *b = (const uint8_t *)rec;
+    uint16_t crc = 0xFFFF;
+    uint8_t i;
 
-    // Return ADC value
-    return ADC;
+    for (i = 0; i < offsetof(rates_t, crc); i++)
+        crc = _crc_ccitt_update(crc, b[i]);
+    return crc;
 }
 
+// Periods from EEPROM; defaults for a missing record or a value out of
+// range
+void rates_load(void)
+{
+    rates_t rec;
+    uint8_t valid, i;
+
+    eeprom_read_block(&rec, &ee_rates, sizeof(rec));
+    valid = rec.magic == RATES_MAGIC && rec.crc == rates_crc(&rec);
+    for (i = 0; i < RATE_COUNT; i++)
+    {
+        if (valid && rec.ms[i] >= rate_cfg[i].min_ms && rec.ms[i] <= RATE_MAX_MS)
+            rate_ms[i] = rec.ms[i];
+        else
+            rate_ms[i] = rate_cfg[i].def_ms;
+    }
+}
 
-// Text description of MQ135 air quality
-const char* get_quality_level(uint16_t value)
+// Store the periods in use; the write blocks for a few ms
+void rates_save(void)
 {
-    if (value < 300) return "EXCELLENT";
-    if (value < 500) return "GOOD";
-    if (value < 700) return "MEDIUM";
-    if (value < 900) return "BAD";
-    return "VERY BAD";
+    rates_t rec;
+    uint8_t i;
+
+    rec.magic = RATES_MAGIC;
+    for (i = 0; i < RATE_COUNT; i++)
+        rec.ms[i] = rate_ms[i];
+    rec.crc = rates_crc(&rec);
+    eeprom_update_block(&rec, &ee_rates, sizeof(rec));
 }
 
-// -------- TIMER1 (1s) INITIALIZATION --------
-void timer1_init(void)
+// Pointer past word when line starts with it, followed by a space or the
+// end; NULL otherwise
+const char *match_word(const char *line, const char *word)
 {
-    tim1_ovf_1sec();    // Timer1 overflow every 1 second
-    tim1_ovf_enable();  // Enable Timer1 overflow interrupt
+    while (*word)
+    {
+        if (*line++ != *word++)
+            return NULL;
+    }
+    return (*line == ' ' || *line == '\0') ? line : NULL;
 }
 
-// ------------------------ MAIN ------------------------
-int main(void)
+// "rate": list the periods; "rate <sensor> <ms>": set one and store it
+void rate_command(const char *line)
 {
-    // Buffers for formatted text
-    char uart_msg[32];    
-    char oled_msg[16];    
+    char msg[32];
+    char *p;
+    const char *arg;
+    uint32_t ms;
+    uint8_t i;
+
+    while (*line == ' ')
+        line++;
+    for (i = 0; i < RATE_COUNT; i++)
+    {
+        if (*line == '\0')
+        {
+            p = fmt_str(fmt_str(msg, rate_cfg[i].name), " ");
+            fmt_str(fmt_uint(p, rate_ms[i], 0, ' '), " ms\r\n");
+            uart_puts(msg);
+        }
+        else if ((arg = match_word(line, rate_cfg[i].name)) != NULL)
+        {
+            if (!parse_uint(arg, RATE_MAX_MS, &ms) || ms < rate_cfg[i].min_ms)
+            {
+                p = fmt_str(fmt_str(msg, rate_cfg[i].name), ": ");
+                p = fmt_str(fmt_uint(p, rate_cfg[i].min_ms, 0, ' '), "..");
+                fmt_str(fmt_uint(p, RATE_MAX_MS, 0, ' '), " ms\r\n");
+                uart_puts(msg);
+                return;
+            }
+            rate_ms[i] = ms;
+            sched_set_period(rate_cfg[i].task, ms);
+            rates_save();
+            uart_puts("OK\r\n");
+            return;
+        }
+    }
+    if (*line != '\0')
+        uart_puts("?\r\n");
+}
 
-    // Initialize peripherals
-    twi_init();                                   // I2C
-    uart_init(UART_BAUD_SELECT(115200, F_CPU));  // UART 115200 baud
-    //mq135_adc_init();                                   // mq135ADC
-    oled_setup();                                 // OLED
-    gp2y1010_init(&dust);                         // GP2Y1010 dust sensor
+// Time a refresh of all display pages at both bus speeds and print the
+// throughput of the pixel data, e.g. "400 kHz: 1024 B in 29.8 ms, 34362 B/s"
+void twi_benchmark(void)
+{
+    static const uint32_t speeds[] = { TWI_SPEED_STANDARD, TWI_SPEED_FAST };
+    char msg[48];
+    char *p;
+    uint32_t t;
+    uint8_t i, line;
 
-    // Timer0 for controlling GP2Y1010 LED (overflow every 16µs)
-    tim0_ovf_16us();
-    tim0_ovf_enable();
+    for (i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++)
+    {
+        twi_set_device_speed(OLED_I2C_ADR, speeds[i]);
+        t = systime_us();
+        for (line = 0; line < DISPLAY_HEIGHT / 8; line++)
+            oled_display_block(0, line, DISPLAY_WIDTH);
+        t = systime_us() - t;
+
+        p = fmt_str(fmt_uint(msg, speeds[i] / 1000, 0, ' '), " kHz: ");
+        p = fmt_str(fmt_uint(p, DISPLAY_WIDTH * DISPLAY_HEIGHT / 8, 0, ' '), " B in ");
+        p = fmt_str(fmt_fixed(p, t / 100, 1, 0), " ms, ");
+        p = fmt_uint(p, t ? (uint32_t)DISPLAY_WIDTH * DISPLAY_HEIGHT / 8 * 1000000UL / t : 0, 0, ' ');
+        fmt_str(p, " B/s\r\n");
+        uart_puts(msg);
+    }
+    twi_set_device_speed(OLED_I2C_ADR, OLED_I2C_SPEED);
+}
 
-    sei();               // Enable global interrupts
-    timer1_init();       // Start Timer1 for periodic measurements
+// One conversion of channel id, awake in a free slot or in ADC Noise
+// Reduction sleep
+uint16_t noise_sample(int8_t id, uint8_t quiet)
+{
+    uint16_t value;
 
-    while (1)
+    while (adc_read(id, &value))
+        ;                   // Drop unread samples
+    adc_request(id);
+    if (quiet)
     {
-        // ---------------- UPDATE OLED ----------------
-        if (flag_update_oled == 1)
+        while (!adc_sleep_convert(adc_quiet_ready))
+            ;
+    }
+    while (!adc_read(id, &value))
+        ;
+    return value;
+}
+
+// ADC_NOISE_MAX conversions of the MQ135 input awake and then quiet;
+// prints mean, standard deviation and peak-to-peak in ADC counts, e.g.
+// "quiet: mean 412.53, sd 0.4, p-p 2", and with raw the samples as a C
+// initializer for the trace replay in test/test_adc. The main loop
+// stops for about 0.4 s (awake conversions wait for the 10 ms dust slot)
+void noise_command(uint8_t raw)
+{
+    uint16_t v[ADC_NOISE_MAX];
+    adc_noise_t st;
+    char msg[48];
+    char *p;
+    uint8_t quiet, i;
+
+    for (quiet = 0; quiet < 2; quiet++)
+    {
+        for (i = 0; i < ADC_NOISE_MAX; i++)
+            v[i] = noise_sample((quiet == MQ135_QUIET) ? mq135_adc : noise_adc, quiet);
+        adc_noise(v, ADC_NOISE_MAX, &st);
+
+        p = fmt_str(msg, quiet ? "quiet: mean " : "awake: mean ");
+        p = fmt_fixed(p, st.mean, 2, 0);
+        p = fmt_str(p, ", sd ");
+        p = fmt_fixed(p, st.sd, 1, 0);
+        p = fmt_str(p, ", p-p ");
+        fmt_str(fmt_uint(p, st.pp, 0, ' '), "\r\n");
+        uart_puts(msg);
+        if (raw)
         {
-            
-
-            // Display raw MQ135 ADC value
-            oled_gotoxy(12,2);
-            oled_puts("     ");                     
-            oled_gotoxy(12,2);
-            sprintf(oled_msg, "%4d", mq135_value);
-            oled_puts(oled_msg);
-
-            // Display textual quality level
-            oled_gotoxy(8,3);
-            oled_puts("             ");
-            oled_gotoxy(8,3);
-            oled_puts(get_quality_level(mq135_value));
-
-            // Temperature from DHT12
-            oled_gotoxy(13,4);
-            oled_puts("        "); 
-            oled_gotoxy(13,4);
-            sprintf(oled_msg, "%u.%u C", dht12_values[2], dht12_values[3]);
-            oled_puts(oled_msg);
-
-            // Humidity from DHT12
-            oled_gotoxy(13,5);
-            oled_puts("        ");
-            oled_gotoxy(13,5);
-            sprintf(oled_msg, "%u.%u %% ", dht12_values[0], dht12_values[1]);
-            oled_puts(oled_msg);
-
-            // Dust concentration GP2Y1010
-            oled_gotoxy(14,6);
-            oled_puts("        ");
-            oled_gotoxy(14,6);
-
-            uint16_t dust_int = (uint16_t)(dust_density);
-            uint16_t dust_dec = (uint16_t)((dust_density - dust_int) * 10);
-
-            sprintf(oled_msg, "%u.%u", dust_int, dust_dec);
-            oled_puts(oled_msg);
-
-            oled_display();  // Refresh OLED content
-
-            flag_update_oled = 0; // Reset flag
+            for (i = 0; i < ADC_NOISE_MAX; i++)
+            {
+                p = fmt_uint(msg, v[i], 0, ' ');
+                fmt_str(p, (i % 16 == 15) ? ",\r\n" : ", ");
+                uart_puts(msg);
+            }
         }
+    }
+}
 
-        // ---------------- UPDATE UART ----------------
-        if (flag_update_uart == 1)
-        {
-            // Temperature
-            sprintf(uart_msg, "Temp: %u.%u C\r\n", dht12_values[2], dht12_values[3]);
-            uart_puts(uart_msg);
+// Move the whole ms of sleep_counts into sleep_ms; called every second,
+// so sleep_counts stays far from its wrap
+void sleep_fold(void)
+{
+    sleep_ms += sleep_counts / (1000 / SCHED_SUBTICK_US);
+    sleep_counts %= 1000 / SCHED_SUBTICK_US;
+}
 
-            // Humidity
-            sprintf(uart_msg, "Humidity: %u.%u %%\r\n", dht12_values[0], dht12_values[1]);
-            uart_puts(uart_msg);
+// Run one received command line
+//   cal [time]  - MQ135 is in clean air now: store R0, and the time
+//                 given by the host (e.g. Unix time), in EEPROM
+//   sched       - runtime, jitter and overrun counters of the tasks, and
+//                 the share of time awake since the last "sched"
+//   rate [sensor ms] - sampling periods of mq135, dust and dht12; set one
+//                 and keep it in EEPROM
+//   twi         - measured display throughput at 100 and 400 kHz
+//   noise [raw] - spread of MQ135 conversions awake and in ADC Noise
+//                 Reduction sleep, raw also lists the samples
+void uart_command(const char *line)
+{
+    char msg[64];           // Longest: a "sched" line, 54 bytes
+    char *p;
+    uint32_t r0, time = 0;
+    sched_stats_t st;
+    const char *name, *arg;
+    uint8_t i;
+    uint32_t window, asleep;
+
+    if (line[0] == 'c' && line[1] == 'a' && line[2] == 'l' &&
+        (line[3] == ' ' || line[3] == '\0'))
+    {
+        line += 3;
+        while (*line == ' ')
+            line++;
+        if (*line != '\0' && !parse_uint(line, UINT32_MAX, &time))
+        {
+            uart_puts("?\r\n");
+            return;
+        }
+        if (!mq135_ready())
+        {
+            uart_puts("MQ135 warming up\r\n");
+            return;
+        }
+        r0 = mq135_calibrate(mq135_rs_corrected(mq135_value,
+                             climate.temp, climate.hum), time);
+        p = fmt_str(msg, r0 ? "R0: " : "R0 not changed");
+        if (r0)
+            p = fmt_str(fmt_uint(p, r0, 0, ' '), " ohm");
+        fmt_str(p, "\r\n");
+        uart_puts(msg);
+        return;
+    }
+    if (line[0] == 's' && line[1] == 'c' && line[2] == 'h' &&
+        line[3] == 'e' && line[4] == 'd' && line[5] == '\0')
+    {
+        // "dust: 812/1024 us, jit 64 us, ovr 0/0"  (overruns/skipped)
+        for (i = 0; (name = sched_get_stats(i, &st)) != NULL; i++)
+        {
+            p = fmt_str(fmt_str(msg, name), ": ");
+            p = fmt_str(fmt_uint(p, st.runtime_last, 0, ' '), "/");
+            p = fmt_str(fmt_uint(p, st.runtime_max, 0, ' '), " us, jit ");
+            p = fmt_str(fmt_uint(p, st.jitter_max, 0, ' '), " us, ovr ");
+            p = fmt_str(fmt_uint(p, st.overruns, 0, ' '), "/");
+            fmt_str(fmt_uint(p, st.skipped, 0, ' '), "\r\n");
+            uart_puts(msg);
+        }
 
-            // MQ135 raw and quality
-            sprintf(uart_msg, "MQ135 raw=%u\r\n", mq135_value);
-            uart_puts(uart_msg);
+        // "awake 3.4 % of 60.0 s"
+        sleep_fold();
+        window = systime_ms() - duty_since;
+        asleep = sleep_ms < window ? sleep_ms : window;    // ms carried over
+        duty_since += window;
+        sleep_ms = 0;
+        p = fmt_str(msg, "awake ");
+        p = fmt_fixed(p, window >= 1000 ? (window - asleep) / (window / 1000) : 1000, 1, 0);
+        p = fmt_str(p, " % of ");
+        p = fmt_fixed(p, window / 100, 1, 0);
+        fmt_str(p, " s\r\n");
+        uart_puts(msg);
+        return;
+    }
+    if (match_word(line, "rate"))
+    {
+        rate_command(line + 4);
+        return;
+    }
+    if (match_word(line, "twi"))
+    {
+        twi_benchmark();
+        return;
+    }
+    if ((arg = match_word(line, "noise")) != NULL)
+    {
+        while (*arg == ' ')
+            arg++;
+        noise_command(match_word(arg, "raw") != NULL);
+        return;
+    }
+    uart_puts("?\r\n");
+}
 
-            // Dust value
-            uint16_t dust_int = (uint16_t)dust_voltage;
-            uint16_t dust_dec = (uint16_t)((dust_voltage - dust_int) * 10);
-            sprintf(uart_msg, "Dust: %u.%u ug/m3\r\n\r\n", dust_int, dust_dec);
-            uart_puts(uart_msg);
+// Collect received characters into a line, run it on CR or LF
+void uart_poll(void)
+{
+    unsigned int c;
 
-            flag_update_uart = 0; // Reset flag
+    while (!((c = uart_getc()) & UART_NO_DATA))
+    {
+        if (c & 0xff00)
+            continue;       // Framing or overrun error, drop the character
+        if (c == '\r' || c == '\n')
+        {
+            if (cmd_len)
+            {
+                cmd_line[cmd_len] = '\0';
+                cmd_len = 0;    // Line complete, "noise" may sleep
+                uart_command(cmd_line);
+            }
         }
+        else if (cmd_len < sizeof(cmd_line) - 1)
+            cmd_line[cmd_len++] = c;
     }
+}
 
-    return 0; // Program never reaches this point
+// Sleep until an interrupt brings work: a released task, an OLED page
+// that can be sent, a quiet MQ135 conversion that can start or a received
+// character. IDLE keeps clkIO running for the dust LED events (Timer0),
+// the scheduler tick (Timer2), TWI and UART. Power-save would stop all of
+// them; Timer2 could only keep counting from a 32 kHz crystal on
+// TOSC1/TOSC2, which carry the 16 MHz resonator on the Uno. Interrupts
+// served while asleep count as sleep time.
+void idle_sleep(void)
+{
+    uint32_t start;
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    cli();
+    while (!sched_pending() && !oled_display_pending() && !uart_rx_ready() &&
+           !(adc_sleep_pending() && adc_quiet_ready()))
+    {
+        start = sched_clock();
+        sleep_enable();
+        sei();              // SLEEP runs before any pending interrupt
+        sleep_cpu();
+        sleep_disable();
+        cli();
+        sleep_counts += sched_clock() - start;
+    }
+    sei();
+}
+
+// " @12.345 s": acquisition time of a reading, s since power-up
+char *fmt_stamp(char *p, uint32_t ms)
+{
+    p = fmt_uint(fmt_str(p, " @"), ms / 1000, 0, ' ');
+    p = fmt_uint(fmt_str(p, "."), ms % 1000, 3, '0');
+    return fmt_str(p, " s");
+}
+
+// Text description of air quality from the CO2 equivalent in ppm
+const char* get_quality_level(uint16_t ppm)
+{
+    if (ppm < 600) return "EXCELLENT";
+    if (ppm < 1000) return "GOOD";
+    if (ppm < 1500) return "MEDIUM";
+    if (ppm < 2500) return "BAD";
+    return "VERY BAD";
+}
+
+// ------------------------ TASKS ------------------------
+// Every second: bus watchdog, duty cycle, DHT12 retries and result
+void task_second(void)
+{
+    // Recover the I2C bus if the background OLED flush got stuck
+    twi_watchdog();
+
+    // Sleep time of the duty cycle into ms
+    sleep_fold();
+
+    // Age the DHT12 sample, retry a failed read; take the last checked
+    // sample, kept if the latest read failed
+    dht12_tick();
+    if (dht12_get(&climate))
+        climate_valid = 1;
 }
 
-// ------------------------ ISR TIMER1 ------------------------
-// Timer1 interrupt every 1 second
-ISR(TIMER1_OVF_vect)
+// MQ135 period: warm-up and CO2 from the last conversion, then request
+// the next
+void task_mq135(void)
 {
-    static uint8_t counter = 0;  // Overflow counter
-    counter++;
+    mq135_value = adc_last_stamped(mq135_adc, &mq135_ms);
 
-    // Perform measurements every 5 seconds
-    if (counter >= 5)
+    // Heater warm-up detection counts in seconds: one sample for each
+    // second the conversion time moved on, so periods above 1 s repeat
+    // it and shorter ones skip conversions
+    while (mq135_ms - mq135_warm_ms >= 1000)
     {
-        counter = 0;
+        mq135_warmup(mq135_value);
+        mq135_warm_ms += 1000;
+    }
+
+    // MQ135 resistance referred to 20 C / 33 %RH, then CO2 ppm;
+    // 0 until the heater has settled
+    mq135_co2 = 0;
+    if (mq135_ready())
+        mq135_co2 = mq135_ppm(mq135_rs_corrected(mq135_value,
+                              climate.temp, climate.hum));
+
+    adc_request(mq135_adc);
+}
 
-        // Read MQ135 sensor
-        mq135_value = mq135_read();     ///MQ135_PIN
+// Dust period: last filtered window of the GP2Y1010
+void task_dust(void)
+{
+    dust_raw = gp2y1010_read_stamped(&dust, &dust_ms);
+    dust_mv = gp2y1010_q4_to_mv(dust_raw);
+    dust_density = gp2y1010_q4_to_density(&dust, dust_raw);
+}
+
+// DHT12 period: queue a read, checked and cached when it arrives and
+// taken by task_second()
+void task_climate(void)
+{
+    dht12_start();
+}
 
-        // Read DHT12 via I2C (5 bytes)
-        twi_readfrom_mem_into(DHT_ADR, DHT_HUM_MEM, dht12_values, 5);
+// Every 5 seconds: draw the latest values
+void task_display(void)
+{
+    char oled_msg[16];
+
+    // Display MQ135 CO2 equivalent
+    oled_gotoxy(12,2);
+    oled_puts("     ");
+    oled_gotoxy(12,2);
+    if (mq135_co2)
+        fmt_uint(oled_msg, mq135_co2, 5, ' ');
+    else
+        fmt_str(oled_msg, " warm");
+    oled_puts(oled_msg);
+
+    // Display textual quality level
+    oled_gotoxy(8,3);
+    oled_puts("             ");
+    oled_gotoxy(8,3);
+    oled_puts(mq135_co2 ? get_quality_level(mq135_co2) : "WARMING UP");
+
+    // Temperature from DHT12
+    oled_gotoxy(13,4);
+    oled_puts("        ");
+    oled_gotoxy(13,4);
+    if (climate_valid)
+        fmt_str(fmt_fixed(oled_msg, climate.temp, 1, 0), " C");
+    else
+        fmt_str(oled_msg, "--");
+    oled_puts(oled_msg);
+
+    // Humidity from DHT12
+    oled_gotoxy(13,5);
+    oled_puts("        ");
+    oled_gotoxy(13,5);
+    if (climate_valid)
+        fmt_str(fmt_fixed(oled_msg, climate.hum, 1, 0), " % ");
+    else
+        fmt_str(oled_msg, "--");
+    oled_puts(oled_msg);
+
+    // Dust concentration GP2Y1010
+    oled_gotoxy(14,6);
+    oled_puts("        ");
+    oled_gotoxy(14,6);
+    fmt_fixed(oled_msg, dust_density, 1, 0);
+    oled_puts(oled_msg);
+
+    oled_display_begin(NULL);  // Send the changed fields in the background
+}
 
-        // Read GP2Y1010 dust sensor
-        dust_raw = gp2y1010_read_raw(&dust);
-        dust_voltage = gp2y1010_adc_to_voltage(dust_raw);
-        dust_density = gp2y1010_voltage_to_density(dust_voltage);
+// After the display: the UART report, each reading with the time it
+// was taken
+void task_report(void)
+{
+    char uart_msg[56];
+    char *p;              // End of the text built so far
 
-        // Request updates in main loop
-        flag_update_oled = 1;
-        flag_update_uart = 1;
+    if (climate_valid)
+    {
+        // Temperature, with the age of a sample kept after failed reads
+        // (older than two DHT12 periods)
+        p = fmt_str(uart_msg, "Temp: ");
+        p = fmt_fixed(p, climate.temp, 1, 0);
+        p = fmt_str(p, " C");
+        if (climate.age > rate_ms[RATE_DHT12] / 500)
+            p = fmt_str(fmt_uint(fmt_str(p, " ("), climate.age, 0, ' '), " s old)");
+        p = fmt_stamp(p, climate.time);
+        fmt_str(p, "\r\n");
+        uart_puts(uart_msg);
+
+        // Humidity
+        p = fmt_str(uart_msg, "Humidity: ");
+        p = fmt_fixed(p, climate.hum, 1, 0);
+        p = fmt_stamp(fmt_str(p, " %"), climate.time);
+        fmt_str(p, "\r\n");
+        uart_puts(uart_msg);
     }
+    else
+        uart_puts("DHT12: no data\r\n");
+
+    // MQ135 CO2 equivalent and raw value
+    p = fmt_str(uart_msg, "CO2: ");
+    if (mq135_co2)
+        p = fmt_str(fmt_uint(p, mq135_co2, 0, ' '), " ppm");
+    else
+        p = fmt_str(p, "warming up");
+    p = fmt_str(p, " (raw ");
+    p = fmt_uint(p, mq135_value, 0, ' ');
+    p = fmt_stamp(fmt_str(p, ")"), mq135_ms);
+    fmt_str(p, "\r\n");
+    uart_puts(uart_msg);
+
+    // Dust value and sensor output
+    p = fmt_str(uart_msg, "Dust: ");
+    p = fmt_fixed(p, dust_density, 1, 0);
+    p = fmt_str(p, " ug/m3 (");
+    p = fmt_uint(p, dust_mv, 0, ' ');
+    p = fmt_stamp(fmt_str(p, " mV)"), dust_ms);
+    fmt_str(p, "\r\n\r\n");
+    uart_puts(uart_msg);
+
+    // Keep the dust sensor's clean-air baseline across resets
+    gp2y1010_baseline_save();
 }
 
+// Task table, highest priority first; periods, first releases and
+// deadlines in ticks (ms). Sensor periods are set from rate_ms[] in main()
+sched_task_t tasks[TASK_COUNT] = {
+    [TASK_SECOND]  = { .run = task_second,  .name = "1s",   .period = TICKS_1S,
+                       .offset = TICKS_1S,      .deadline = 30 },
+    [TASK_MQ135]   = { .run = task_mq135,   .name = "mq",   .period = TICKS_1S,
+                       .offset = TICKS_1S + 10, .deadline = 30 },
+    [TASK_DUST]    = { .run = task_dust,    .name = "dust", .period = TICKS_1S,
+                       .offset = TICKS_1S + 20, .deadline = 30 },
+    [TASK_CLIMATE] = { .run = task_climate, .name = "dht",  .period = TICKS_5S,
+                       .offset = TICKS_1S + 30, .deadline = 30 },
+    [TASK_DISPLAY] = { .run = task_display, .name = "oled", .period = TICKS_5S,
+                       .offset = TICKS_5S + 50, .deadline = 60 },
+    [TASK_REPORT]  = { .run = task_report,  .name = "uart", .period = TICKS_5S,
+                       .offset = TICKS_5S + 70, .deadline = 130 },
+};
 
+// ------------------------ MAIN ------------------------
+int main(void)
+{
+    uint8_t i;
 
+    // Initialize peripherals
+    twi_init();                                   // I2C
+    uart_init(UART_BAUD_SELECT(115200, F_CPU));  // UART 115200 baud
+    adc_init();                                   // ADC service
+    mq135_adc_init();                             // MQ135 on ADC0
+    mq135_init();                                 // MQ135 R0 from EEPROM
+    oled_setup();                                 // OLED
+    gp2y1010_init(&dust);                         // GP2Y1010 dust sensor (starts its timer)
+    sched_init(tasks, TASK_COUNT);
+    rates_load();                                 // Sensor periods from EEPROM
+    for (i = 0; i < RATE_COUNT; i++)
+        sched_set_period(rate_cfg[i].task, rate_ms[i]);
 
+    sei();               // Enable global interrupts
+    systime_init();      // Start Timer2: 1 ms time base and scheduler tick
+    duty_since = systime_ms();
 
+    while (1)
+    {
+        // ---------------- PERIODIC TASKS ----------------
+        // At most one released task per loop pass
+        sched_run();
 
+        // ---------------- OLED FLUSH ----------------
+        // At most one page per loop pass, so the UART report is not delayed
+        oled_display_step(DISPLAY_WIDTH);
 
+        // ---------------- QUIET ADC ----------------
+        // Requested MQ135 conversion, once the bus and UART are idle
+        adc_sleep_convert(adc_quiet_ready);
 
+        // ---------------- UART COMMANDS ----------------
+        uart_poll();
 
+        // ---------------- SLEEP ----------------
+        // Until the next interrupt that leaves work for the loop
+        idle_sleep();
+    }
+
+    return 0; // Program never reaches this point
+}
+
+// ------------------------ ISR TIMER2 ------------------------
+// Timer2 compare match every 1 ms (Timer1 may be taken by the GP2Y1010
+// library, GP2Y1010_HW_PULSE): only the time base and the scheduler
+// tick, all sensor I/O runs in the tasks
+ISR(TIMER2_COMPA_vect)
+{
+    systime_tick();
+    sched_tick();
+}
@@ -0,0 +1,96 @@
+/*
+ * Flush benchmark of the OLED shadow modes, included after oled_bus.h by
+ * one suite per mode (test_oled_none, test_oled, test_oled_full).
+ *
+ * The screen of main.c is drawn and synced, then oled_display() flushes
+ * the unchanged frame and a task_display() update that rewrites all five
+ * fields (three values change, two stay the same). Each suite prints one
+ * row of the table in oled.h: shadow RAM, and the wire bytes with the
+ * bus time at 400 kHz (9 SCL periods per byte, START/STOP left out).
+ */
+
+#ifndef OLED_BENCH_H
+#define OLED_BENCH_H
+
+#include <stdio.h>
+
+#if OLED_SHADOW == OLED_SHADOW_NONE
+# define BENCH_MODE   "NONE"
+# define BENCH_SHADOW 0
+#elif OLED_SHADOW == OLED_SHADOW_CHECKSUM
+# define BENCH_MODE   "CHECKSUM"
+# define BENCH_SHADOW (sizeof(shadow) + sizeof(shadowStale))
+#else
+# define BENCH_MODE   "FULL"
+# define BENCH_SHADOW (sizeof(shadow) + sizeof(shadowStale))
+#endif
+
+#define BENCH_US(bytes) ((bytes) * 45UL / 2)       // 22.5 µs per byte at 400 kHz
+
+static void bench_field(uint8_t x, uint8_t y, uint8_t blank, const char *value)
+{
+    static const char spaces[] = "             ";
+
+    oled_gotoxy(x, y);
+    oled_puts(spaces + sizeof(spaces) - 1 - blank);
+    oled_gotoxy(x, y);
+    oled_puts(value);
+}
+
+// task_display() of main.c with the given values
+static void bench_fields(const char *co2, const char *level, const char *temp,
+                         const char *hum, const char *dust)
+{
+    bench_field(12, 2, 5, co2);
+    bench_field(8, 3, 13, level);
+    bench_field(13, 4, 8, temp);
+    bench_field(13, 5, 8, hum);
+    bench_field(14, 6, 8, dust);
+}
+
+static void test_benchmark_shadow_modes(void)
+{
+    uint32_t same, update;
+    char msg[120];
+
+    memset(displayBuffer, 0, sizeof(displayBuffer));
+    oled_charMode(DOUBLESIZE);
+    oled_gotoxy(0, 0);
+    oled_puts("INDOOR AIR Q");
+    oled_charMode(NORMALSIZE);
+    oled_gotoxy(0, 2);
+    oled_puts("CO2 [ppm]:");
+    oled_gotoxy(0, 3);
+    oled_puts("Level:");
+    oled_gotoxy(0, 4);
+    oled_puts("Temp [°C]:");
+    oled_gotoxy(0, 5);
+    oled_puts("Humidity [%]:");
+    oled_gotoxy(0, 6);
+    oled_puts("Dust [ug/m3]:");
+    bench_fields("  812", "GOOD", "23.4 C", "45.1 % ", "12.0");
+    oled_display();
+
+    bus_reset();
+    oled_display();
+    same = bus_wire;
+
+    bench_fields("  815", "GOOD", "23.5 C", "45.1 % ", "14.5");
+    bus_reset();
+    oled_display();
+    update = bus_wire;
+#if OLED_SHADOW == OLED_SHADOW_NONE
+    TEST_ASSERT_EQUAL(same, update);            // every column, every time
+#else
+    TEST_ASSERT_EQUAL(0, same);
+#endif
+
+    snprintf(msg, sizeof(msg),
+             "%-8s shadow %4u B, unchanged %4lu B %4lu.%lu ms, 5 fields %4lu B %4lu.%lu ms",
+             BENCH_MODE, (unsigned)BENCH_SHADOW,
+             (unsigned long)same, BENCH_US(same) / 1000, BENCH_US(same) / 100 % 10,
+             (unsigned long)update, BENCH_US(update) / 1000, BENCH_US(update) / 100 % 10);
+    TEST_MESSAGE(msg);
+}
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Simulated TWI bus for the OLED test suites, included after oled.c.
+ *
+ * The TWI library is replaced by the functions below: blocking transfers
+ * complete at once, asynchronous ones stay pending until the test calls
+ * bus_finish(). Every data transfer is recorded with its page, first
+ * column and width, decoded from the SH1106 page prefix. bus_wire counts
+ * the bytes after START as the bus carries them (address, control byte,
+ * prefix, data), bus_data the display data bytes alone.
+ */
+
+#ifndef OLED_BUS_H
+#define OLED_BUS_H
+
+#define BUS_LOG 64
+
+static struct {
+    uint8_t line, x, width;
+} bus_log[BUS_LOG];
+static uint8_t bus_count;           // Data transfers recorded
+static uint32_t bus_wire;           // Bytes on the wire
+static uint32_t bus_data;           // Display data bytes
+static twi_xfer_t *bus_pending;     // Asynchronous transfer on the bus
+static uint8_t bus_fail;            // Let the next transfer fail
+
+static void bus_reset(void)
+{
+    bus_count = 0;
+    bus_wire = bus_data = 0;
+    bus_pending = NULL;
+    bus_fail = 0;
+}
+
+static void bus_record(const twi_xfer_t *xfer)
+{
+    const uint8_t *prefix = xfer->wbuf;
+
+    bus_wire += 1 + ((xfer->flags & TWI_XFER_MEMADDR) ? 1 : 0) + xfer->wlen;
+    for (uint8_t i = 0; i < xfer->wiovcnt; i++)
+    {
+        bus_wire += xfer->wiov[i].len;
+        bus_data += xfer->wiov[i].len;
+    }
+    if ((xfer->flags & TWI_XFER_MEMADDR) && xfer->memaddr == 0x40)
+        bus_data += xfer->wlen;             // oled_data()
+
+    if (xfer->wiovcnt == 0 || bus_count >= BUS_LOG)
+        return;
+    bus_log[bus_count].line = prefix[1] - 0xb0;
+    bus_log[bus_count].x = ((prefix[7] & 0x0f) << 4 | (prefix[5] & 0x0f)) - 2;
+    bus_log[bus_count].width = xfer->wiov[0].len;
+    bus_count++;
+}
+
+static uint8_t bus_result(void)
+{
+    uint8_t status = bus_fail ? TWI_XFER_ERROR : TWI_XFER_DONE;
+
+    bus_fail = 0;
+    return status;
+}
+
+static void bus_finish(void)
+{
+    TEST_ASSERT_NOT_NULL(bus_pending);
+    bus_pending->status = bus_result();
+    bus_pending = NULL;
+}
+
+void twi_init(void) {}
+
+uint8_t twi_set_device_speed(uint8_t addr, uint32_t scl_hz)
+{
+    (void)addr;
+    (void)scl_hz;
+    return 0;
+}
+
+uint8_t twi_submit(twi_xfer_t *xfer)
+{
+    TEST_ASSERT_NULL(bus_pending);
+    bus_record(xfer);
+    xfer->status = TWI_XFER_PENDING;
+    bus_pending = xfer;
+    return 0;
+}
+
+uint8_t twi_transfer(twi_xfer_t *xfer)
+{
+    bus_record(xfer);
+    xfer->status = bus_result();
+    return xfer->status == TWI_XFER_ERROR;
+}
+
+#endif
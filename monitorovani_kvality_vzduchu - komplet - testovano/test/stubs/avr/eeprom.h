@@ -0,0 +1,28 @@
+#ifndef STUB_AVR_EEPROM_H
+#define STUB_AVR_EEPROM_H
+/*
+ * Host stand-in for <avr/eeprom.h>: EEMEM variables live in RAM and the
+ * block functions copy to and from them. avr_stub_ee_writes counts the
+ * update calls.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define EEMEM
+
+static uint16_t avr_stub_ee_writes __attribute__((unused)) = 0;
+
+static inline void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+    memcpy(dst, src, n);
+}
+
+static inline void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+    memcpy(dst, src, n);
+    avr_stub_ee_writes++;
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef STUB_AVR_INTERRUPT_H
+#define STUB_AVR_INTERRUPT_H
+/*
+ * Host stand-in for <avr/interrupt.h>: an ISR is an ordinary function
+ * that the test calls where the hardware would raise the interrupt.
+ * sei()/cli() only track the I bit in SREG.
+ */
+
+#include <avr/io.h>
+
+#define ISR(vector) void vector(void); void vector(void)
+#define sei() (SREG |= (1 << SREG_I))
+#define cli() (SREG &= ~(1 << SREG_I))
+
+#endif
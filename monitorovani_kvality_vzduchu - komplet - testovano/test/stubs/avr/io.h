@@ -0,0 +1,124 @@
+#ifndef STUB_AVR_IO_H
+#define STUB_AVR_IO_H
+/*
+ * Host stand-in for <avr/io.h> (native test environment).
+ *
+ * Registers are plain variables, one set per test program; a test
+ * includes the sources under test into its own translation unit and
+ * drives or inspects the registers directly.
+ */
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+#define RAMEND   0x8FF
+
+#define AVR_STUB_REG8(name)  static volatile uint8_t name __attribute__((unused));
+#define AVR_STUB_REG16(name) static volatile uint16_t name __attribute__((unused));
+
+AVR_STUB_REG8(TWCR) AVR_STUB_REG8(TWSR) AVR_STUB_REG8(TWBR) AVR_STUB_REG8(TWDR)
+AVR_STUB_REG8(PORTB) AVR_STUB_REG8(DDRB) AVR_STUB_REG8(PINB)
+AVR_STUB_REG8(PORTC) AVR_STUB_REG8(DDRC) AVR_STUB_REG8(PINC)
+AVR_STUB_REG8(PORTD) AVR_STUB_REG8(DDRD) AVR_STUB_REG8(PIND)
+AVR_STUB_REG8(ADMUX) AVR_STUB_REG8(ADCSRA) AVR_STUB_REG8(ADCSRB) AVR_STUB_REG16(ADC)
+AVR_STUB_REG8(TCCR0A) AVR_STUB_REG8(TCCR0B) AVR_STUB_REG8(TCNT0) AVR_STUB_REG8(OCR0A)
+AVR_STUB_REG8(TIMSK0) AVR_STUB_REG8(TIFR0)
+AVR_STUB_REG8(TCCR1A) AVR_STUB_REG8(TCCR1B) AVR_STUB_REG16(TCNT1) AVR_STUB_REG16(OCR1A)
+AVR_STUB_REG16(OCR1B) AVR_STUB_REG16(ICR1) AVR_STUB_REG8(TIMSK1) AVR_STUB_REG8(TIFR1)
+AVR_STUB_REG8(TCCR2A) AVR_STUB_REG8(TCCR2B) AVR_STUB_REG8(TCNT2) AVR_STUB_REG8(OCR2A)
+AVR_STUB_REG8(TIMSK2) AVR_STUB_REG8(TIFR2)
+AVR_STUB_REG8(UCSR0A) AVR_STUB_REG8(UCSR0B) AVR_STUB_REG8(UCSR0C) AVR_STUB_REG8(UDR0)
+AVR_STUB_REG8(UBRR0H) AVR_STUB_REG8(UBRR0L)
+AVR_STUB_REG8(SPCR) AVR_STUB_REG8(SPSR) AVR_STUB_REG8(SPDR)
+AVR_STUB_REG8(SREG) AVR_STUB_REG8(SMCR)
+
+/* Bit positions (ATmega328P) */
+#define TWINT 7
+#define TWEA  6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC  3
+#define TWEN  2
+#define TWIE  0
+#define TWPS1 1
+#define TWPS0 0
+
+#define REFS1 7
+#define REFS0 6
+#define ADEN  7
+#define ADSC  6
+#define ADATE 5
+#define ADIF  4
+#define ADIE  3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define ADTS2 2
+#define ADTS1 1
+#define ADTS0 0
+
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define WGM01 1
+#define WGM10 0
+#define WGM11 1
+#define WGM12 3
+#define WGM13 4
+#define WGM21 1
+#define COM1A0 6
+#define COM1A1 7
+#define COM1B0 4
+#define COM1B1 5
+
+#define TOIE0  0
+#define OCIE0A 1
+#define TOIE1  0
+#define OCIE1A 1
+#define OCIE1B 2
+#define TOIE2  0
+#define OCIE2A 1
+#define TOV0   0
+#define OCF0A  1
+#define TOV1   0
+#define OCF1A  1
+#define OCF1B  2
+#define TOV2   0
+#define OCF2A  1
+#define OCF2B  2
+
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB5 5
+#define PD0 0
+
+#define RXC0   7
+#define TXC0   6
+#define UDRE0  5
+#define FE0    4
+#define DOR0   3
+#define UPE0   2
+#define U2X0   1
+#define RXCIE0 7
+#define TXCIE0 6
+#define UDRIE0 5
+#define RXEN0  4
+#define TXEN0  3
+#define UCSZ01 2
+#define UCSZ00 1
+
+#define SPE  6
+#define MSTR 4
+#define SPR0 0
+#define SPIF 7
+
+#define SREG_I 7
+
+#endif
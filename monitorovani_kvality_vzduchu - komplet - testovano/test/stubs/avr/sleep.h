@@ -0,0 +1,24 @@
+#ifndef STUB_AVR_SLEEP_H
+#define STUB_AVR_SLEEP_H
+/*
+ * Host stand-in for <avr/sleep.h>. sleep_cpu() calls avr_stub_sleep(),
+ * which a test defines to deliver the interrupt that would wake the CPU.
+ */
+
+#include <stdint.h>
+
+#define SLEEP_MODE_IDLE     0
+#define SLEEP_MODE_ADC      2
+#define SLEEP_MODE_PWR_DOWN 4
+#define SLEEP_MODE_PWR_SAVE 6
+
+void avr_stub_sleep(void);
+
+static uint8_t avr_stub_sleep_mode __attribute__((unused)) = 0;
+
+#define set_sleep_mode(mode) (avr_stub_sleep_mode = (mode))
+#define sleep_enable()       ((void)0)
+#define sleep_disable()      ((void)0)
+#define sleep_cpu()          avr_stub_sleep()
+
+#endif
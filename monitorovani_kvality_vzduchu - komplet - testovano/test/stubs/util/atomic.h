@@ -0,0 +1,13 @@
+#ifndef STUB_UTIL_ATOMIC_H
+#define STUB_UTIL_ATOMIC_H
+/* Host stand-in for <util/atomic.h>: the tests are single-threaded */
+
+#define ATOMIC_RESTORESTATE    0
+#define ATOMIC_FORCEON         1
+#define NONATOMIC_RESTORESTATE 0
+#define NONATOMIC_FORCEOFF     1
+
+#define ATOMIC_BLOCK(type)    for (int avr_stub_once = 1; avr_stub_once; avr_stub_once = 0)
+#define NONATOMIC_BLOCK(type) for (int avr_stub_once = 1; avr_stub_once; avr_stub_once = 0)
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef STUB_UTIL_DELAY_H
+#define STUB_UTIL_DELAY_H
+/*
+ * Host stand-in for <util/delay.h>: delays do not wait, they advance
+ * avr_stub_us, the simulated time a test can read.
+ */
+
+#include <stdint.h>
+
+static uint32_t avr_stub_us __attribute__((unused)) = 0;
+
+static inline void _delay_us(double us) { avr_stub_us += (uint32_t)us; }
+static inline void _delay_ms(double ms) { avr_stub_us += (uint32_t)(ms * 1000); }
+
+#endif
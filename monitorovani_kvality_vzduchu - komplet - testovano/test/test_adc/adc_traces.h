@@ -0,0 +1,26 @@
+#ifndef ADC_TRACES_H
+#define ADC_TRACES_H
+/*
+ * MQ135 conversion traces for the noise replay in test_adc.c, ADC
+ * counts. The lines are in the format printed by the "noise raw" UART
+ * command: paste the awake block into adc_trace_awake[] and the quiet
+ * block into adc_trace_quiet[].
+ *
+ * No board capture is recorded yet. Until one replaces them these are
+ * synthetic: Gaussian noise around 412.3 counts with a standard
+ * deviation of 1.5 counts awake and 0.5 counts quiet, rounded to codes.
+ */
+
+#include <adc.h>
+
+static const uint16_t adc_trace_awake[ADC_NOISE_MAX] = {
+    412, 414, 411, 411, 413, 409, 410, 412, 411, 412, 414, 415, 410, 412, 414, 414,
+    413, 413, 410, 413, 412, 412, 415, 412, 410, 411, 412, 414, 408, 412, 412, 411,
+};
+
+static const uint16_t adc_trace_quiet[ADC_NOISE_MAX] = {
+    412, 413, 412, 413, 413, 413, 411, 412, 412, 411, 412, 413, 412, 413, 413, 413,
+    412, 413, 412, 412, 412, 413, 412, 411, 413, 412, 412, 412, 412, 413, 412, 412,
+};
+
+#endif
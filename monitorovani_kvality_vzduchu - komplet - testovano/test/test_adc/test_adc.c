@@ -0,0 +1,302 @@
+/*
+ * Host tests of the ADC service: slot arbitration and latency.
+ *
+ * A simulated ADC converts the input selected in ADMUX when ADSC is
+ * set and raises ADC_vect ADC_CONVERSION_US later, with 100 × the input
+ * number as result. Latencies are measured in simulated µs from the
+ * request or trigger to the channel callback.
+ *
+ * The noise benchmark replays recorded traces instead: a conversion
+ * that completes with the CPU awake returns the next awake sample, one
+ * in ADC Noise Reduction sleep the next quiet sample (adc_traces.h).
+ */
+
+#include <unity.h>
+#include <math.h>
+#include "adc.c"
+#include "adc_traces.h"
+
+
+// -- Simulated hardware -----------------------------------
+#define SIM_STEP_US 4
+
+static uint32_t sim_us;
+static uint8_t sim_converting;
+static uint32_t sim_conv_start;
+static uint8_t sim_conv_mux;
+static uint8_t sim_asleep;          // CPU in ADC Noise Reduction sleep
+static uint8_t sim_replay;          // Results from the traces
+static uint8_t sim_awake_next, sim_quiet_next;
+
+#define SIM_LOG 16
+static struct {
+    uint8_t id;
+    uint16_t value;
+    uint32_t us;
+} sim_log[SIM_LOG];
+static uint8_t sim_log_count;
+
+uint32_t systime_ms(void)
+{
+    return sim_us / 1000;
+}
+
+static void sim_step(void)
+{
+    sim_us += SIM_STEP_US;
+    if (!sim_converting && (ADCSRA & (1 << ADSC)))
+    {
+        sim_converting = 1;
+        sim_conv_start = sim_us - SIM_STEP_US;  // started by the last write
+        sim_conv_mux = ADMUX & 0x0F;
+    }
+    if (sim_converting && sim_us - sim_conv_start >= ADC_CONVERSION_US)
+    {
+        sim_converting = 0;
+        ADCSRA &= ~(1 << ADSC);
+        if (!sim_replay)
+            ADC = sim_conv_mux * 100;
+        else if (sim_asleep)
+            ADC = adc_trace_quiet[sim_quiet_next++ % ADC_NOISE_MAX];
+        else
+            ADC = adc_trace_awake[sim_awake_next++ % ADC_NOISE_MAX];
+        sim_asleep = 0;                         // ADC_vect wakes the CPU
+        ADC_vect();
+    }
+}
+
+static void sim_run_us(uint32_t us)
+{
+    uint32_t end = sim_us + us;
+
+    while (sim_us < end)
+        sim_step();
+}
+
+void avr_stub_sleep(void)
+{
+    TEST_ASSERT_EQUAL(SLEEP_MODE_ADC, avr_stub_sleep_mode);
+    TEST_ASSERT_TRUE(SREG & (1 << SREG_I));
+    sim_asleep = 1;
+    while (sim_asleep)
+        sim_step();
+}
+
+static void sim_done(void *arg, uint16_t value)
+{
+    if (sim_log_count < SIM_LOG)
+    {
+        sim_log[sim_log_count].id = (uint8_t)(uintptr_t)arg;
+        sim_log[sim_log_count].value = value;
+        sim_log[sim_log_count].us = sim_us;
+        sim_log_count++;
+    }
+}
+
+static int8_t sim_register(uint8_t mux, uint8_t flags)
+{
+    return adc_register(mux, flags, sim_done, (void *)(uintptr_t)adc_channel_count);
+}
+
+static uint8_t sim_ready(void)
+{
+    return 1;
+}
+
+
+// -- Tests ------------------------------------------------
+void setUp(void)
+{
+    sim_us = 0;
+    sim_converting = 0;
+    sim_log_count = 0;
+    sim_replay = sim_awake_next = sim_quiet_next = 0;
+    SREG = 1 << SREG_I;
+    adc_channel_count = 0;
+    adc_timed = adc_quiet = adc_pending = adc_timed_pending = adc_quiet_pending = 0;
+    adc_busy = adc_auto = ADC_NONE;
+    memset(adc_channels, 0, sizeof(adc_channels));
+    adc_init();
+}
+
+void tearDown(void) {}
+
+static void test_free_request_starts_at_once_without_timed_channel(void)
+{
+    int8_t a = sim_register(3, 0);
+    uint16_t value;
+    uint32_t stamp;
+
+    adc_request(a);
+    sim_run_us(100);
+    TEST_ASSERT_EQUAL(1, sim_log_count);
+    TEST_ASSERT_EQUAL(ADC_CONVERSION_US, sim_log[0].us);    // latency
+    TEST_ASSERT_EQUAL(1, adc_read(a, &value));
+    TEST_ASSERT_EQUAL(300, value);
+    TEST_ASSERT_EQUAL(0, adc_read(a, &value));
+    TEST_ASSERT_EQUAL(300, adc_last_stamped(a, &stamp));
+}
+
+static void test_free_requests_follow_timed_slot(void)
+{
+    int8_t t = sim_register(5, ADC_TIMED);
+    int8_t a = sim_register(0, 0);
+    int8_t b = sim_register(1, 0);
+
+    adc_request(b);
+    adc_request(a);
+    sim_run_us(1000);
+    TEST_ASSERT_EQUAL(0, sim_log_count);        // no free conversion alone
+
+    adc_trigger(t);
+    sim_run_us(1000);
+    TEST_ASSERT_EQUAL(3, sim_log_count);
+    TEST_ASSERT_EQUAL(t, sim_log[0].id);        // timed slot first
+    TEST_ASSERT_EQUAL(1000 + ADC_CONVERSION_US, sim_log[0].us);
+    TEST_ASSERT_EQUAL(a, sim_log[1].id);        // then lowest id first
+    TEST_ASSERT_EQUAL(b, sim_log[2].id);
+    TEST_ASSERT_EQUAL(100, sim_log[2].value);
+    TEST_ASSERT_EQUAL(1000 + 3 * ADC_CONVERSION_US, sim_log[2].us);
+}
+
+static void test_timed_slot_delayed_by_one_conversion_at_most(void)
+{
+    int8_t t = sim_register(5, ADC_TIMED);
+    int8_t a = sim_register(0, 0);
+    int8_t b = sim_register(1, 0);
+    char msg[80];
+
+    adc_trigger(t);
+    adc_request(a);
+    adc_request(b);
+    sim_run_us(ADC_CONVERSION_US + 8);          // a is converting now
+    TEST_ASSERT_EQUAL(1, sim_log_count);
+
+    uint32_t trigger_us = sim_us;
+    adc_trigger(t);                             // sampling point comes
+    sim_run_us(1000);
+    TEST_ASSERT_EQUAL(4, sim_log_count);
+    TEST_ASSERT_EQUAL(a, sim_log[1].id);
+    TEST_ASSERT_EQUAL(t, sim_log[2].id);        // before b
+    TEST_ASSERT_EQUAL(b, sim_log[3].id);
+    TEST_ASSERT_LESS_OR_EQUAL(2 * ADC_CONVERSION_US, sim_log[2].us - trigger_us);
+    snprintf(msg, sizeof(msg), "worst case, timed slot behind a running conversion: result after %lu us",
+             (unsigned long)(sim_log[2].us - trigger_us));
+    TEST_MESSAGE(msg);
+}
+
+static void test_ring_keeps_latest_samples(void)
+{
+    int8_t a = sim_register(2, 0);
+    uint16_t value;
+
+    for (uint8_t i = 0; i < ADC_RING_SIZE + 2; i++)
+    {
+        adc_request(a);
+        sim_run_us(ADC_CONVERSION_US);
+    }
+    for (uint8_t i = 0; i < ADC_RING_SIZE; i++)
+        TEST_ASSERT_EQUAL(1, adc_read(a, &value));
+    TEST_ASSERT_EQUAL(0, adc_read(a, &value));
+}
+
+static void test_quiet_request_waits_for_sleep(void)
+{
+    int8_t q = sim_register(4, ADC_QUIET);
+
+    adc_request(q);
+    sim_run_us(1000);
+    TEST_ASSERT_EQUAL(0, sim_log_count);
+    TEST_ASSERT_EQUAL(1, adc_sleep_pending());
+
+    TEST_ASSERT_EQUAL(1, adc_sleep_convert(sim_ready));
+    TEST_ASSERT_EQUAL(1, sim_log_count);
+    TEST_ASSERT_EQUAL(400, sim_log[0].value);
+    TEST_ASSERT_EQUAL(0, adc_sleep_pending());
+    TEST_ASSERT_EQUAL(0, adc_sleep_convert(sim_ready));
+}
+
+// Mean and standard deviation in double precision
+static void ref_noise(const uint16_t *v, uint8_t n, double *mean, double *sd)
+{
+    double sum = 0, sq = 0;
+
+    for (uint8_t i = 0; i < n; i++)
+        sum += v[i];
+    *mean = sum / n;
+    for (uint8_t i = 0; i < n; i++)
+        sq += (v[i] - *mean) * (v[i] - *mean);
+    *sd = sqrt(sq / n);
+}
+
+static void test_noise_statistics_against_float(void)
+{
+    static const uint16_t flat[4] = { 500, 500, 500, 500 };
+    static const uint16_t extreme[ADC_NOISE_MAX] = {
+        0, 1023, 0, 1023, 0, 1023, 0, 1023, 0, 1023, 0, 1023, 0, 1023, 0, 1023,
+        0, 1023, 0, 1023, 0, 1023, 0, 1023, 0, 1023, 0, 1023, 0, 1023, 0, 1023,
+    };
+    const uint16_t *traces[] = { adc_trace_awake, adc_trace_quiet, extreme };
+    adc_noise_t st;
+    double mean, sd;
+
+    adc_noise(flat, 4, &st);
+    TEST_ASSERT_EQUAL(50000, st.mean);
+    TEST_ASSERT_EQUAL(0, st.sd);
+    TEST_ASSERT_EQUAL(0, st.pp);
+
+    for (uint8_t t = 0; t < 3; t++)
+    {
+        adc_noise(traces[t], ADC_NOISE_MAX, &st);
+        ref_noise(traces[t], ADC_NOISE_MAX, &mean, &sd);
+        TEST_ASSERT_EQUAL((uint32_t)(mean * 100), st.mean);
+        TEST_ASSERT_EQUAL((uint16_t)(sd * 10 + 1e-9), st.sd);   // rounded down
+    }
+    TEST_ASSERT_EQUAL(1023, st.pp);
+}
+
+static void test_noise_benchmark_replays_traces(void)
+{
+    int8_t awake = sim_register(0, 0);
+    int8_t quiet = sim_register(0, ADC_QUIET);
+    uint16_t v[2][ADC_NOISE_MAX];
+    adc_noise_t st[2];
+    char msg[100];
+
+    sim_replay = 1;
+    for (uint8_t i = 0; i < ADC_NOISE_MAX; i++)
+    {
+        adc_request(awake);                     // free slot, CPU running
+        sim_run_us(ADC_CONVERSION_US);
+        TEST_ASSERT_EQUAL(1, adc_read(awake, &v[0][i]));
+
+        adc_request(quiet);                     // Noise Reduction sleep
+        TEST_ASSERT_EQUAL(1, adc_sleep_convert(sim_ready));
+        TEST_ASSERT_EQUAL(1, adc_read(quiet, &v[1][i]));
+    }
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(adc_trace_awake, v[0], ADC_NOISE_MAX);
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(adc_trace_quiet, v[1], ADC_NOISE_MAX);
+
+    for (uint8_t q = 0; q < 2; q++)
+    {
+        adc_noise(v[q], ADC_NOISE_MAX, &st[q]);
+        snprintf(msg, sizeof(msg), "%s: mean %lu.%02lu, sd %u.%u, p-p %u counts",
+                 q ? "quiet" : "awake", (unsigned long)st[q].mean / 100,
+                 (unsigned long)st[q].mean % 100, st[q].sd / 10, st[q].sd % 10, st[q].pp);
+        TEST_MESSAGE(msg);
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(st[0].sd, st[1].sd);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_free_request_starts_at_once_without_timed_channel);
+    RUN_TEST(test_free_requests_follow_timed_slot);
+    RUN_TEST(test_timed_slot_delayed_by_one_conversion_at_most);
+    RUN_TEST(test_ring_keeps_latest_samples);
+    RUN_TEST(test_quiet_request_waits_for_sleep);
+    RUN_TEST(test_noise_statistics_against_float);
+    RUN_TEST(test_noise_benchmark_replays_traces);
+    return UNITY_END();
+}
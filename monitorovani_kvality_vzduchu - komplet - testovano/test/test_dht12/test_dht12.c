@@ -0,0 +1,155 @@
+/*
+ * Host tests of the DHT12 frame check and decoding.
+ *
+ * Frames are built with their checksum by frame(); a bad checksum or
+ * digit is made by changing one byte afterwards. The last test passes
+ * a frame through the TWI callback to the cache: twi_submit() only
+ * keeps the transaction, and the test completes it.
+ */
+
+#include <unity.h>
+#include "dht12.c"
+
+
+// -- Stubs ------------------------------------------------
+static twi_xfer_t *bus_xfer;        // Last submitted transaction
+
+uint8_t twi_submit(twi_xfer_t *xfer)
+{
+    xfer->status = TWI_XFER_PENDING;
+    bus_xfer = xfer;
+    return 0;
+}
+
+uint32_t systime_ms(void)
+{
+    return 12345;
+}
+
+// Raw frame of hum_int.hum_dec %RH and ±temp_int.temp_dec C
+static uint8_t *frame(uint8_t *f, uint8_t hum_int, uint8_t hum_dec,
+                      uint8_t temp_int, uint8_t temp_dec, uint8_t negative)
+{
+    f[0] = hum_int;
+    f[1] = hum_dec;
+    f[2] = temp_int;
+    f[3] = temp_dec | (negative ? 0x80 : 0);
+    f[4] = f[0] + f[1] + f[2] + f[3];
+    return f;
+}
+
+
+// -- Tests ------------------------------------------------
+void setUp(void)
+{
+    bus_xfer = NULL;
+    dht12_valid = 0;
+}
+
+void tearDown(void) {}
+
+static void test_positive_temperature(void)
+{
+    uint8_t f[DHT12_FRAME_LEN];
+    dht12_sample_t s;
+
+    TEST_ASSERT_EQUAL(DHT12_OK, dht12_decode(frame(f, 45, 3, 23, 7, 0), &s));
+    TEST_ASSERT_EQUAL(237, s.temp);
+    TEST_ASSERT_EQUAL(453, s.hum);
+    TEST_ASSERT_EQUAL(0, s.age);
+    TEST_ASSERT_EQUAL(0, s.time);
+}
+
+static void test_negative_temperature(void)
+{
+    uint8_t f[DHT12_FRAME_LEN];
+    dht12_sample_t s;
+
+    TEST_ASSERT_EQUAL(DHT12_OK, dht12_decode(frame(f, 60, 0, 12, 5, 1), &s));
+    TEST_ASSERT_EQUAL(-125, s.temp);
+    TEST_ASSERT_EQUAL(600, s.hum);
+
+    TEST_ASSERT_EQUAL(DHT12_OK, dht12_decode(frame(f, 60, 0, 0, 4, 1), &s));
+    TEST_ASSERT_EQUAL(-4, s.temp);              // -0.4 C, integer part 0
+}
+
+static void test_zero_humidity_accepted(void)
+{
+    uint8_t f[DHT12_FRAME_LEN];
+    dht12_sample_t s;
+
+    TEST_ASSERT_EQUAL(DHT12_OK, dht12_decode(frame(f, 0, 0, 21, 0, 0), &s));
+    TEST_ASSERT_EQUAL(0, s.hum);
+    TEST_ASSERT_EQUAL(210, s.temp);
+
+    // 0.0 %RH at 0.0 C is valid too if the sign bit is set
+    TEST_ASSERT_EQUAL(DHT12_OK, dht12_decode(frame(f, 0, 0, 0, 0, 1), &s));
+    TEST_ASSERT_EQUAL(0, s.temp);
+}
+
+static void test_all_zero_frame_refused(void)
+{
+    uint8_t f[DHT12_FRAME_LEN];
+    dht12_sample_t s = { .temp = 111, .hum = 222 };
+
+    TEST_ASSERT_EQUAL(DHT12_ERR_RANGE, dht12_decode(frame(f, 0, 0, 0, 0, 0), &s));
+    TEST_ASSERT_EQUAL(111, s.temp);             // not written
+    TEST_ASSERT_EQUAL(222, s.hum);
+}
+
+static void test_bad_checksum(void)
+{
+    uint8_t f[DHT12_FRAME_LEN];
+    dht12_sample_t s = { .temp = 111, .hum = 222 };
+
+    frame(f, 45, 3, 23, 7, 0)[4]++;
+    TEST_ASSERT_EQUAL(DHT12_ERR_SUM, dht12_decode(f, &s));
+    frame(f, 45, 3, 23, 7, 0)[2] ^= 0x01;       // one bit flipped in transit
+    TEST_ASSERT_EQUAL(DHT12_ERR_SUM, dht12_decode(f, &s));
+    TEST_ASSERT_EQUAL(111, s.temp);
+}
+
+static void test_bad_digit_or_range(void)
+{
+    uint8_t f[DHT12_FRAME_LEN];
+    dht12_sample_t s;
+
+    TEST_ASSERT_EQUAL(DHT12_ERR_RANGE, dht12_decode(frame(f, 45, 10, 23, 7, 0), &s));
+    TEST_ASSERT_EQUAL(DHT12_ERR_RANGE, dht12_decode(frame(f, 45, 3, 23, 10, 0), &s));
+    TEST_ASSERT_EQUAL(DHT12_ERR_RANGE, dht12_decode(frame(f, 45, 3, 23, 10, 1), &s));
+    TEST_ASSERT_EQUAL(DHT12_ERR_RANGE, dht12_decode(frame(f, 101, 0, 23, 0, 0), &s));
+    TEST_ASSERT_EQUAL(DHT12_ERR_RANGE, dht12_decode(frame(f, 45, 0, 81, 0, 0), &s));
+    TEST_ASSERT_EQUAL(DHT12_OK, dht12_decode(frame(f, 100, 0, 80, 9, 0), &s));
+}
+
+static void test_frame_reaches_cache(void)
+{
+    uint8_t f[DHT12_FRAME_LEN];
+    dht12_sample_t s;
+
+    dht12_start();
+    TEST_ASSERT_NOT_NULL(bus_xfer);
+    frame(f, 0, 0, 19, 5, 0);                   // dry air, still cached
+    for (uint8_t i = 0; i < DHT12_FRAME_LEN; i++)
+        bus_xfer->rbuf[i] = f[i];
+    bus_xfer->status = TWI_XFER_DONE;
+    bus_xfer->callback(bus_xfer);
+
+    TEST_ASSERT_EQUAL(1, dht12_get(&s));
+    TEST_ASSERT_EQUAL(195, s.temp);
+    TEST_ASSERT_EQUAL(0, s.hum);
+    TEST_ASSERT_EQUAL(12345, s.time);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_positive_temperature);
+    RUN_TEST(test_negative_temperature);
+    RUN_TEST(test_zero_humidity_accepted);
+    RUN_TEST(test_all_zero_frame_refused);
+    RUN_TEST(test_bad_checksum);
+    RUN_TEST(test_bad_digit_or_range);
+    RUN_TEST(test_frame_reaches_cache);
+    return UNITY_END();
+}
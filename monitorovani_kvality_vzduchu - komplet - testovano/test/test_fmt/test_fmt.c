@@ -0,0 +1,255 @@
+/*
+ * Host tests of the fmt library against the C library's snprintf().
+ *
+ * Every 16-bit value (the range of the ADC, sensor and fixed-point
+ * readings on the display and UART paths) is compared in all field
+ * widths, pads and decimal counts used by the application. The rest of
+ * the 32-bit range is covered by the values around each power of ten
+ * and a pseudo-random sample.
+ *
+ * The benchmark prints host nanoseconds per call for fmt and snprintf.
+ * On a PC with hardware division snprintf is usually faster; fmt pays
+ * off on the AVR, where each 32-bit division is a library call of
+ * several hundred cycles and vfprintf needs more than 1 KB of flash.
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "fmt.c"
+
+
+// -- References -------------------------------------------
+static void ref_uint(char *ref, uint32_t value, uint8_t width, char pad)
+{
+    snprintf(ref, 32, pad == '0' ? "%0*lu" : "%*lu", width, (unsigned long)value);
+}
+
+static void ref_int(char *ref, int32_t value, uint8_t width, char pad)
+{
+    snprintf(ref, 32, pad == '0' ? "%0*ld" : "%*ld", width, (long)value);
+}
+
+static void ref_fixed(char *ref, int32_t value, uint8_t decimals, uint8_t width)
+{
+    char num[32], frac[16];
+    uint32_t mag = value < 0 ? -(uint32_t)value : (uint32_t)value;
+    uint32_t scale = 1;
+
+    for (uint8_t i = 0; i < decimals; i++)
+        scale *= 10;
+    if (decimals == 0)
+        snprintf(num, sizeof(num), "%s%lu", value < 0 ? "-" : "",
+                 (unsigned long)mag);
+    else
+    {
+        snprintf(frac, sizeof(frac), "%010lu", (unsigned long)(mag % scale));
+        snprintf(num, sizeof(num), "%s%lu.%s", value < 0 ? "-" : "",
+                 (unsigned long)(mag / scale), frac + 10 - decimals);
+    }
+    snprintf(ref, 32, "%*s", width, num);
+}
+
+
+// -- Checks -----------------------------------------------
+static void check_uint(uint32_t value, uint8_t width, char pad)
+{
+    char buf[32], ref[32];
+    char *end = fmt_uint(buf, value, width, pad);
+
+    ref_uint(ref, value, width, pad);
+    TEST_ASSERT_EQUAL_STRING(ref, buf);
+    TEST_ASSERT_EQUAL(strlen(ref), end - buf);
+}
+
+static void check_int(int32_t value, uint8_t width, char pad)
+{
+    char buf[32], ref[32];
+    char *end = fmt_int(buf, value, width, pad);
+
+    ref_int(ref, value, width, pad);
+    TEST_ASSERT_EQUAL_STRING(ref, buf);
+    TEST_ASSERT_EQUAL(strlen(ref), end - buf);
+}
+
+static void check_fixed(int32_t value, uint8_t decimals, uint8_t width)
+{
+    char buf[32], ref[32];
+    char *end = fmt_fixed(buf, value, decimals, width);
+
+    ref_fixed(ref, value, decimals, width);
+    TEST_ASSERT_EQUAL_STRING(ref, buf);
+    TEST_ASSERT_EQUAL(strlen(ref), end - buf);
+}
+
+/* Values around every power of ten and the type limits */
+static void edge_values(void (*check)(int64_t value))
+{
+    static const int64_t limits[] = {
+        0, INT32_MAX, INT32_MIN, (int64_t)INT32_MAX + 1, UINT32_MAX
+    };
+    int64_t p = 1;
+
+    for (uint8_t i = 0; i <= 10; i++, p *= 10)
+        for (int8_t d = -1; d <= 1; d++)
+        {
+            check(p + d);
+            check(-p + d);
+        }
+    for (uint8_t i = 0; i < sizeof(limits)/sizeof(limits[0]); i++)
+        for (int8_t d = -1; d <= 1; d++)
+            check(limits[i] + d);
+}
+
+static uint32_t rand32_state = 0x12345678;
+
+static uint32_t rand32(void)
+{
+    rand32_state ^= rand32_state << 13;     // xorshift32
+    rand32_state ^= rand32_state >> 17;
+    rand32_state ^= rand32_state << 5;
+    return rand32_state;
+}
+
+
+// -- Tests ------------------------------------------------
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_uint_all_16_bit_values(void)
+{
+    for (uint32_t v = 0; v <= UINT16_MAX; v++)
+        for (uint8_t w = 0; w <= 6; w++)
+        {
+            check_uint(v, w, ' ');
+            check_uint(v, w, '0');
+        }
+}
+
+static void test_int_all_16_bit_values(void)
+{
+    for (int32_t v = INT16_MIN; v <= INT16_MAX; v++)
+        for (uint8_t w = 0; w <= 7; w++)
+        {
+            check_int(v, w, ' ');
+            check_int(v, w, '0');
+        }
+}
+
+static void test_fixed_all_16_bit_values(void)
+{
+    for (int32_t v = INT16_MIN; v <= INT16_MAX; v++)
+        for (uint8_t d = 0; d <= 3; d++)
+        {
+            check_fixed(v, d, 0);
+            check_fixed(v, d, 6);
+        }
+}
+
+static void check_edge(int64_t value)
+{
+    if (value >= 0 && value <= UINT32_MAX)
+        for (uint8_t w = 0; w <= 12; w += 4)
+            check_uint((uint32_t)value, w, '0');
+    if (value >= INT32_MIN && value <= INT32_MAX)
+        for (uint8_t w = 0; w <= 12; w += 4)
+        {
+            check_int((int32_t)value, w, '0');
+            for (uint8_t d = 0; d <= 9; d++)
+                check_fixed((int32_t)value, d, w);
+        }
+}
+
+static void test_32_bit_edges(void)
+{
+    edge_values(check_edge);
+}
+
+static void test_32_bit_random(void)
+{
+    for (uint32_t i = 0; i < 200000; i++)
+    {
+        uint32_t v = rand32() >> (rand32() & 31);  // all magnitudes
+
+        check_uint(v, 0, ' ');
+        check_int((int32_t)v, 0, ' ');
+        check_fixed((int32_t)v, (uint8_t)(i % 4), 0);
+    }
+}
+
+static void test_width_narrower_than_number(void)
+{
+    char buf[16];
+
+    fmt_int(buf, -12345, 3, '0');
+    TEST_ASSERT_EQUAL_STRING("-12345", buf);
+    fmt_fixed(buf, -5, 2, 1);
+    TEST_ASSERT_EQUAL_STRING("-0.05", buf);
+}
+
+static void test_str_chains(void)
+{
+    char buf[32];
+    char *p = fmt_str(buf, "Temp: ");
+
+    p = fmt_fixed(p, -53, 1, 0);
+    p = fmt_str(p, " C");
+    TEST_ASSERT_EQUAL_STRING("Temp: -5.3 C", buf);
+    TEST_ASSERT_EQUAL('\0', *p);
+    TEST_ASSERT_EQUAL(strlen(buf), p - buf);
+}
+
+static double bench_ns(clock_t start, uint32_t calls)
+{
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / calls;
+}
+
+static void test_benchmark_against_snprintf(void)
+{
+    enum { CALLS = 2000000 };
+    char buf[32];
+    volatile char sink = 0;
+    clock_t start;
+    double t_fmt, t_ref;
+    char msg[120];
+
+    start = clock();
+    for (uint32_t i = 0; i < CALLS; i++)
+    {
+        fmt_fixed(buf, (int32_t)(i * 7919u) - 1000000, 1, 6);
+        sink ^= buf[0];
+    }
+    t_fmt = bench_ns(start, CALLS);
+
+    start = clock();
+    for (uint32_t i = 0; i < CALLS; i++)
+    {
+        int32_t v = (int32_t)(i * 7919u) - 1000000;
+        uint32_t mag = v < 0 ? -(uint32_t)v : (uint32_t)v;
+
+        snprintf(buf, sizeof(buf), "%s%lu.%lu", v < 0 ? "-" : "",
+                 (unsigned long)(mag / 10), (unsigned long)(mag % 10));
+        sink ^= buf[0];
+    }
+    t_ref = bench_ns(start, CALLS);
+
+    snprintf(msg, sizeof(msg), "fixed-point, host: fmt %.0f ns, snprintf %.0f ns per call",
+             t_fmt, t_ref);
+    TEST_MESSAGE(msg);
+    (void)sink;
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_uint_all_16_bit_values);
+    RUN_TEST(test_int_all_16_bit_values);
+    RUN_TEST(test_fixed_all_16_bit_values);
+    RUN_TEST(test_32_bit_edges);
+    RUN_TEST(test_32_bit_random);
+    RUN_TEST(test_width_narrower_than_number);
+    RUN_TEST(test_str_chains);
+    RUN_TEST(test_benchmark_against_snprintf);
+    return UNITY_END();
+}
@@ -0,0 +1,313 @@
+/*
+ * Host tests of the GP2Y1010 driver with the Timer0 event state machine.
+ *
+ * The ADC service and the driver run against a simulated ATmega328P:
+ * Timer0 counts every 16 µs (prescaler 256) and raises TIMER0_COMPA_vect
+ * on a compare match; a conversion started with ADSC samples the LED
+ * of the sensor on the selected channel 6 µs later (1.5 ADC clocks) and
+ * raises ADC_vect after 52 µs. The driver is built for two sensors, the
+ * second one registered only by the test that runs both.
+ * Interrupts take no simulated time, so the tests check the timing the
+ * driver sets up and count the interrupts; their cycle cost is not
+ * simulated.
+ */
+
+#define GP2Y1010_MAX_SENSORS 2
+#include <unity.h>
+#include <math.h>
+#include "adc.c"
+#include "gp2y1010.c"
+
+
+// -- Simulated hardware -----------------------------------
+#define SIM_STEP_US   2
+#define SIM_SENSORS   GP2Y1010_MAX_SENSORS
+#define SIM_DUST_HIGH 400           // ADC output while the LED is on
+#define SIM_DUST_LOW  100
+
+static const uint8_t sim_led_pin[SIM_SENSORS] = { 2, 3 };   // PD2, PD3
+static const uint8_t sim_analog[SIM_SENSORS] = { 5, 4 };
+
+static uint32_t sim_us;             // Time since the start of the test
+static uint16_t sim_compa_count;    // TIMER0_COMPA_vect calls
+static uint16_t sim_adc_count;      // ADC_vect calls
+
+static uint8_t sim_converting;
+static uint8_t sim_conv_sensor;     // Sensor on the selected channel, or SIM_SENSORS
+static uint32_t sim_conv_start;
+static uint16_t sim_conv_value;
+
+// Per sensor: LED edges and sample-and-hold times
+#define SIM_EDGES 256
+static uint32_t sim_led_on[SIM_SENSORS][SIM_EDGES], sim_led_off[SIM_SENSORS][SIM_EDGES];
+static uint16_t sim_on_count[SIM_SENSORS], sim_off_count[SIM_SENSORS];
+static uint32_t sim_hold[SIM_SENSORS][SIM_EDGES];
+static uint16_t sim_hold_count[SIM_SENSORS];
+
+static GP2Y1010 sim_sensor[SIM_SENSORS];
+
+uint32_t systime_ms(void)
+{
+    return sim_us / 1000;
+}
+
+void avr_stub_sleep(void) {}                // adc_sleep_convert() not used
+
+static uint8_t sim_led_is_on(uint8_t k)
+{
+    return !(PORTD & (1 << sim_led_pin[k]));    // active low
+}
+
+static void sim_run_us(uint32_t us)
+{
+    uint32_t end = sim_us + us;
+    uint8_t led[SIM_SENSORS];
+
+    for (uint8_t k = 0; k < SIM_SENSORS; k++)
+        led[k] = sim_led_is_on(k);
+    while (sim_us < end)
+    {
+        uint8_t tcnt_before = TCNT0;
+
+        sim_us += SIM_STEP_US;
+        TCNT0 = (uint8_t)(sim_us / 16);
+        if (TCNT0 != tcnt_before && TCNT0 == OCR0A && (TIMSK0 & (1 << OCIE0A)))
+        {
+            sim_compa_count++;
+            TIMER0_COMPA_vect();
+        }
+
+        for (uint8_t k = 0; k < SIM_SENSORS; k++)
+        {
+            if (sim_led_is_on(k) == led[k])
+                continue;
+            led[k] = !led[k];
+            if (led[k] && sim_on_count[k] < SIM_EDGES)
+                sim_led_on[k][sim_on_count[k]++] = sim_us;
+            if (!led[k] && sim_off_count[k] < SIM_EDGES)
+                sim_led_off[k][sim_off_count[k]++] = sim_us;
+        }
+
+        if (!sim_converting && (ADCSRA & (1 << ADSC)))
+        {
+            sim_converting = 1;
+            sim_conv_start = sim_us;
+            for (sim_conv_sensor = 0; sim_conv_sensor < SIM_SENSORS; sim_conv_sensor++)
+                if ((ADMUX & 0x0f) == sim_analog[sim_conv_sensor])
+                    break;
+        }
+        if (sim_converting && sim_us - sim_conv_start == 6)
+        {
+            uint8_t k = sim_conv_sensor;
+
+            sim_conv_value = (k < SIM_SENSORS && led[k]) ? SIM_DUST_HIGH : SIM_DUST_LOW;
+            if (k < SIM_SENSORS && sim_hold_count[k] < SIM_EDGES)
+                sim_hold[k][sim_hold_count[k]++] = sim_us;
+        }
+        if (sim_converting && sim_us - sim_conv_start >= ADC_CONVERSION_US)
+        {
+            sim_converting = 0;
+            ADCSRA &= ~(1 << ADSC);
+            ADC = sim_conv_value;
+            sim_adc_count++;
+            ADC_vect();
+        }
+    }
+}
+
+static void sim_add_sensor(uint8_t k)
+{
+    memset(&sim_sensor[k], 0, sizeof(sim_sensor[k]));
+    sim_sensor[k].ledPin = sim_led_pin[k];
+    sim_sensor[k].analogPin = sim_analog[k];
+    gp2y1010_init(&sim_sensor[k]);
+    TEST_ASSERT_EQUAL(k, sim_sensor[k].adc);
+}
+
+// Pulses of sensor k in the record: 320 µs, sampled 278 µs in
+// (datasheet 280 µs), one every 10 ms
+static void check_pulses(uint8_t k, uint16_t pulses)
+{
+    TEST_ASSERT_EQUAL(pulses, sim_on_count[k]);
+    TEST_ASSERT_EQUAL(pulses, sim_off_count[k]);
+    TEST_ASSERT_EQUAL(pulses, sim_hold_count[k]);
+    for (uint16_t i = 0; i < pulses; i++)
+    {
+        TEST_ASSERT_EQUAL(320, sim_led_off[k][i] - sim_led_on[k][i]);
+        TEST_ASSERT_EQUAL(278, sim_hold[k][i] - sim_led_on[k][i]);
+        if (i > 0)
+            TEST_ASSERT_EQUAL(10000, sim_led_on[k][i] - sim_led_on[k][i - 1]);
+    }
+}
+
+
+// -- Tests ------------------------------------------------
+void setUp(void)
+{
+    sim_us = 0;
+    TCNT0 = 0;
+    TIMSK0 = 0;
+    PORTD = 0;
+    sim_converting = 0;
+    sim_compa_count = sim_adc_count = 0;
+    memset(sim_on_count, 0, sizeof(sim_on_count));
+    memset(sim_off_count, 0, sizeof(sim_off_count));
+    memset(sim_hold_count, 0, sizeof(sim_hold_count));
+
+    adc_channel_count = 0;                      // fresh ADC service and driver
+    adc_timed = adc_quiet = adc_pending = adc_timed_pending = adc_quiet_pending = 0;
+    adc_busy = adc_auto = ADC_NONE;
+    sensor_count = 0;
+    adc_init();
+    sim_add_sensor(0);
+}
+
+void tearDown(void) {}
+
+static void test_pulse_and_sample_timing(void)
+{
+    sim_run_us(100000);
+    check_pulses(0, 10);
+    TEST_ASSERT_EQUAL(SIM_DUST_HIGH, gp2y1010_read_raw(&sim_sensor[0]));
+}
+
+static void test_two_sensors_interleaved(void)
+{
+    sim_add_sensor(1);
+    sim_run_us(100000);
+
+    check_pulses(0, 10);
+    check_pulses(1, 10);
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        // Half a frame apart: neither pulse nor conversion overlaps
+        TEST_ASSERT_EQUAL(GP2Y1010_FRAME / 2 * 16, sim_led_on[1][i] - sim_led_on[0][i]);
+        TEST_ASSERT_GREATER_THAN(sim_led_off[0][i], sim_led_on[1][i]);
+        if (i + 1 < 10)
+            TEST_ASSERT_GREATER_THAN(sim_led_off[1][i], sim_led_on[0][i + 1]);
+    }
+    TEST_ASSERT_EQUAL(SIM_DUST_HIGH, gp2y1010_read_raw(&sim_sensor[0]));
+    TEST_ASSERT_EQUAL(SIM_DUST_HIGH, gp2y1010_read_raw(&sim_sensor[1]));
+}
+
+static void test_interrupt_rate(void)
+{
+    char msg[100];
+
+    sim_run_us(1000000);
+
+    // 3 events per frame plus 3 wake-ups in the 9.7 ms gap, where the
+    // 8-bit compare can reach at most GP2Y1010_MAX_WAIT ticks ahead
+    TEST_ASSERT_EQUAL(100, sim_adc_count);
+    TEST_ASSERT_UINT_WITHIN(1, 600, sim_compa_count);
+    snprintf(msg, sizeof(msg), "per second: %u TIMER0_COMPA, %u ADC",
+             sim_compa_count, sim_adc_count);
+    TEST_MESSAGE(msg);
+}
+
+static void test_quiet_outside_pulse(void)
+{
+    sim_run_us(5000);                           // LED pulse over
+    TEST_ASSERT_EQUAL(1, gp2y1010_quiet());
+    while (sim_on_count[0] == 1)
+        sim_run_us(SIM_STEP_US);
+    TEST_ASSERT_EQUAL(0, gp2y1010_quiet());     // next pulse running
+}
+
+// Feed whole filter windows of a sample pattern, return the last result
+static uint16_t feed_windows(uint8_t windows, uint16_t (*pattern)(uint16_t i))
+{
+    for (uint16_t i = 0; i < (uint16_t)windows * GP2Y1010_WINDOW; i++)
+        gp2y1010_sample(&sim_sensor[0], pattern(i));
+    return gp2y1010_read_filtered(&sim_sensor[0]);
+}
+
+static uint16_t level_100(uint16_t i) { (void)i; return 100; }
+static uint16_t level_200(uint16_t i) { (void)i; return 200; }
+static uint16_t spikes(uint16_t i) { return (i % 10 == 5) ? 1023 : (i % 10 == 7) ? 0 : 100; }
+static uint16_t dither(uint16_t i) { return 100 + (i & 1); }
+
+static void test_filter_constant_input(void)
+{
+    TEST_ASSERT_EQUAL(0, gp2y1010_read_filtered(&sim_sensor[0]));
+    TEST_ASSERT_EQUAL(100 * 16, feed_windows(1, level_100));
+}
+
+static void test_filter_step_settles_in_one_window(void)
+{
+    TEST_ASSERT_EQUAL(100 * 16, feed_windows(1, level_100));
+    // The sample that the median holds back is the window minimum
+    TEST_ASSERT_EQUAL(200 * 16, feed_windows(1, level_200));
+    TEST_ASSERT_EQUAL(100 * 16, feed_windows(1, level_100));
+}
+
+static void test_filter_removes_single_spikes(void)
+{
+    TEST_ASSERT_EQUAL(100 * 16, feed_windows(2, spikes));
+}
+
+static void test_filter_resolves_fractions(void)
+{
+    // Alternating codes 100/101 average to 100.5 counts = 1608 in Q4
+    TEST_ASSERT_EQUAL(1608, feed_windows(2, dither));
+}
+
+static void test_fixed_point_conversion_against_float(void)
+{
+    double max_mv = 0, max_density = 0;
+    char msg[100];
+
+    TEST_ASSERT_EQUAL(0, sim_sensor[0].base);      // GP2Y1010_V0_MV in use
+    // Every ADC code and every Q4 fraction between, up to full scale
+    for (uint16_t q4 = 0; q4 <= 1023 * 16; q4++)
+    {
+        double v = q4 / 16.0 * 5.0 / 1023.0;
+        double density = gp2y1010_voltage_to_density((float)v) * 10.0;
+        double e_mv = fabs(gp2y1010_q4_to_mv(q4) - v * 1000.0);
+        double e_density = fabs(gp2y1010_q4_to_density(&sim_sensor[0], q4) - density);
+
+        if (e_mv > max_mv) max_mv = e_mv;
+        if (e_density > max_density) max_density = e_density;
+    }
+    // Less than one unit: 1 mV, 0.1 ug/m3
+    TEST_ASSERT_LESS_THAN(1.0, max_mv);
+    TEST_ASSERT_LESS_THAN(1.0, max_density);
+    snprintf(msg, sizeof(msg), "largest error: %.3f mV, %.3f x 0.1 ug/m3",
+             max_mv, max_density);
+    TEST_MESSAGE(msg);
+
+    // End points
+    TEST_ASSERT_EQUAL(0, gp2y1010_q4_to_density(&sim_sensor[0], 0));
+    TEST_ASSERT_EQUAL(5000, gp2y1010_q4_to_mv(1023 * 16));
+}
+
+static void test_baseline_rise_rate(void)
+{
+    // Windows in 10 min at 10 ms per sample
+    uint16_t windows = 600000UL / (10UL * GP2Y1010_WINDOW);
+
+    base_update(&sim_sensor[0], 1000);
+    TEST_ASSERT_EQUAL(1000, gp2y1010_baseline(&sim_sensor[0]));
+    for (uint16_t i = 0; i < windows; i++)
+        base_update(&sim_sensor[0], 2000);         // dirtier air
+    TEST_ASSERT_EQUAL(1001, gp2y1010_baseline(&sim_sensor[0]));   // 1 Q4 unit
+
+    base_update(&sim_sensor[0], 900);              // cleaner air, followed fast
+    TEST_ASSERT_LESS_THAN(980, gp2y1010_baseline(&sim_sensor[0]));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_pulse_and_sample_timing);
+    RUN_TEST(test_two_sensors_interleaved);
+    RUN_TEST(test_interrupt_rate);
+    RUN_TEST(test_quiet_outside_pulse);
+    RUN_TEST(test_filter_constant_input);
+    RUN_TEST(test_filter_step_settles_in_one_window);
+    RUN_TEST(test_filter_removes_single_spikes);
+    RUN_TEST(test_filter_resolves_fractions);
+    RUN_TEST(test_fixed_point_conversion_against_float);
+    RUN_TEST(test_baseline_rise_rate);
+    return UNITY_END();
+}
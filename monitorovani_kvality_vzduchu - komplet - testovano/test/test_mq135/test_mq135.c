@@ -0,0 +1,223 @@
+/*
+ * Host tests of the MQ135 fixed-point math.
+ *
+ * mq135_ppm() is compared with the datasheet curve it tabulates,
+ * ppm = 116.602 * (Rs/R0)^-2.769, for every Q12 ratio of the table
+ * range and three values of R0 (small, default, large, so both scaling
+ * paths run).
+ *
+ * The calibration record goes through the EEPROM stub, where ee_cal is
+ * ordinary memory that a test can corrupt. Warm-up tests feed one
+ * reading per call, as one per second on the target.
+ */
+
+#include <unity.h>
+#include <math.h>
+#include "mq135.c"
+
+
+// -- References -------------------------------------------
+static double ref_ppm(double ratio)
+{
+    return 116.602 * pow(ratio, -2.769);
+}
+
+
+// -- Tests ------------------------------------------------
+void setUp(void)
+{
+    memset(&ee_cal, 0xFF, sizeof(ee_cal));      // erased EEPROM
+    mq135_init();
+}
+
+void tearDown(void) {}
+
+static void test_rs_edges(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(MQ135_RS_OPEN, mq135_rs(0));
+    TEST_ASSERT_EQUAL_UINT32(MQ135_RL_OHM * 1022, mq135_rs(1));
+    TEST_ASSERT_EQUAL_UINT32(0, mq135_rs(1023));
+    TEST_ASSERT_EQUAL_UINT32(0, mq135_rs(2000));            // clamped
+    TEST_ASSERT_EQUAL_UINT32(MQ135_RL_OHM * 511 / 512, mq135_rs(512));
+}
+
+static void test_correction_table_points(void)
+{
+    for (uint8_t i = 0; i < MQ135_T_POINTS - 1; i++)
+        TEST_ASSERT_EQUAL(mq135_temp_q12[i],
+                          mq135_correction(MQ135_T_MIN + i * MQ135_T_STEP, MQ135_RH_REF));
+
+    // Half-way between two points
+    TEST_ASSERT_EQUAL((4062 + 3666) / 2, mq135_correction(250, MQ135_RH_REF));
+}
+
+static void test_correction_clamps(void)
+{
+    uint16_t f_max = 3556 + (3733 - 3556) * 99 / 100;       // 49.9 C
+
+    TEST_ASSERT_EQUAL(6972, mq135_correction(-100, MQ135_RH_REF));
+    TEST_ASSERT_EQUAL(6972, mq135_correction(-400, MQ135_RH_REF));
+    TEST_ASSERT_EQUAL(f_max, mq135_correction(499, MQ135_RH_REF));
+    TEST_ASSERT_EQUAL(f_max, mq135_correction(500, MQ135_RH_REF));
+    TEST_ASSERT_EQUAL(f_max, mq135_correction(900, MQ135_RH_REF));
+
+    // Humidity term, and the floor at 0.25 for wet, warm air
+    TEST_ASSERT_EQUAL(4062 + 330 * MQ135_RH_Q22 / 1024, mq135_correction(200, 0));
+    TEST_ASSERT_EQUAL(4062 - 670 * MQ135_RH_Q22 / 1024, mq135_correction(200, 1000));
+    TEST_ASSERT_EQUAL(1024, mq135_correction(500, 60000));
+}
+
+static void test_ppm_against_curve(void)
+{
+    static const uint32_t r0s[] = { 4096, MQ135_R0_OHM, 1000000 };
+    double e100 = 0, e10 = 0;
+    char msg[100];
+
+    for (uint8_t k = 0; k < 3; k++)
+    {
+        mq135_set_r0(r0s[k]);
+        for (uint32_t q = mq135_curve[0].ratio; q <= mq135_curve[MQ135_POINTS - 1].ratio; q++)
+        {
+            uint32_t rs = (uint64_t)q * r0s[k] / 4096;
+            double ref = ref_ppm((double)rs / r0s[k]);
+            double e = fabs(mq135_ppm(rs) - ref) / ref * 100;
+
+            if (ref > 100 && e > e100) e100 = e;
+            if (ref > 10 && e > e10) e10 = e;
+        }
+    }
+    TEST_ASSERT_LESS_THAN(1.7, e100);
+    TEST_ASSERT_LESS_THAN(9.5, e10);
+    snprintf(msg, sizeof(msg), "largest error: %.2f %% above 100 ppm, %.2f %% above 10 ppm",
+             e100, e10);
+    TEST_MESSAGE(msg);
+
+    // Clamped outside the table
+    mq135_set_r0(4096);
+    TEST_ASSERT_EQUAL(10057, mq135_ppm(500));
+    TEST_ASSERT_EQUAL(6, mq135_ppm(12000));
+    TEST_ASSERT_EQUAL(6, mq135_ppm(MQ135_RS_OPEN));
+}
+
+static void test_clean_air_ratio(void)
+{
+    double curve = 4096 * pow(MQ135_CLEAN_PPM / 116.602, -1 / 2.769);
+
+    // The inverse of the table, 0.3 % above the curve's 2624
+    TEST_ASSERT_EQUAL(2631, mq135_ratio(MQ135_CLEAN_PPM));
+    TEST_ASSERT_UINT_WITHIN(8, (uint16_t)(curve + 0.5), mq135_ratio(MQ135_CLEAN_PPM));
+
+    // So Rs = R0 * ratio reads back as the clean-air concentration,
+    // within the truncation of Rs
+    mq135_set_r0(MQ135_R0_OHM);
+    TEST_ASSERT_UINT_WITHIN(1, MQ135_CLEAN_PPM,
+                            mq135_ppm(MQ135_R0_OHM * mq135_ratio(MQ135_CLEAN_PPM) / 4096));
+}
+
+static void test_calibrate_reload_round_trip(void)
+{
+    uint32_t r0 = mq135_calibrate(50000, 1760000000UL);
+
+    TEST_ASSERT_EQUAL_UINT32(50000UL * 4096 / 2631, r0);
+    TEST_ASSERT_EQUAL_UINT32(r0, mq135_get_r0());
+
+    mq135_set_r0(0);                            // forget it in RAM
+    TEST_ASSERT_EQUAL_UINT32(MQ135_R0_OHM, mq135_get_r0());
+    TEST_ASSERT_EQUAL(1, mq135_init());
+    TEST_ASSERT_EQUAL_UINT32(r0, mq135_get_r0());
+    TEST_ASSERT_EQUAL_UINT32(1760000000UL, mq135_cal_time());
+
+    // Invalid readings store nothing
+    TEST_ASSERT_EQUAL_UINT32(0, mq135_calibrate(0, 1));
+    TEST_ASSERT_EQUAL_UINT32(0, mq135_calibrate(MQ135_RS_OPEN, 1));
+    TEST_ASSERT_EQUAL(1, mq135_init());
+    TEST_ASSERT_EQUAL_UINT32(r0, mq135_get_r0());
+}
+
+static void test_erased_or_corrupt_record_falls_back(void)
+{
+    TEST_ASSERT_EQUAL(0, mq135_init());         // erased
+    TEST_ASSERT_EQUAL_UINT32(MQ135_R0_OHM, mq135_get_r0());
+    TEST_ASSERT_EQUAL_UINT32(0, mq135_cal_time());
+
+    mq135_calibrate(50000, 1);
+    ee_cal.r0 ^= 0x100;                         // CRC no longer matches
+    TEST_ASSERT_EQUAL(0, mq135_init());
+    TEST_ASSERT_EQUAL_UINT32(MQ135_R0_OHM, mq135_get_r0());
+
+    mq135_calibrate(50000, 1);
+    ee_cal.magic ^= 1;                          // record of another layout
+    ee_cal.crc = mq135_cal_crc(&ee_cal);
+    TEST_ASSERT_EQUAL(0, mq135_init());
+    TEST_ASSERT_EQUAL_UINT32(MQ135_R0_OHM, mq135_get_r0());
+}
+
+// Seconds until mq135_warmup() reports ready, 0 if not within limit
+static uint16_t warm_seconds_until_ready(uint16_t (*counts)(uint16_t s), uint16_t limit)
+{
+    for (uint16_t s = 1; s <= limit; s++)
+    {
+        if (mq135_warmup(counts(s)))
+            return s;
+    }
+    return 0;
+}
+
+static uint16_t flat_input(uint16_t s) { (void)s; return 400; }
+static uint16_t ramp_input(uint16_t s) { return 300 + s / 10; }   // 3 counts per window
+
+static void test_warmup_not_before_min_with_flat_input(void)
+{
+    // Settled after 3 windows (90 s), held back to the minimum
+    TEST_ASSERT_EQUAL(MQ135_WARMUP_MIN_S, warm_seconds_until_ready(flat_input, 2000));
+    TEST_ASSERT_EQUAL(1, mq135_ready());
+    TEST_ASSERT_EQUAL(1, mq135_warmup(900));    // stays ready
+}
+
+static void test_warmup_forced_at_max_with_ramp(void)
+{
+    TEST_ASSERT_EQUAL(MQ135_WARMUP_MAX_S, warm_seconds_until_ready(ramp_input, 2000));
+    TEST_ASSERT_EQUAL(0, warm_flat);
+}
+
+static void test_warmup_window_moving_resets_flat_count(void)
+{
+    uint16_t s;
+
+    for (s = 0; s < 2 * MQ135_SLOPE_WINDOW_S; s++)
+        mq135_warmup(400);
+    TEST_ASSERT_EQUAL(2, warm_flat);
+
+    // 1 count: the average moves less than MQ135_SLOPE_MAX, still flat
+    for (s = 0; s < MQ135_SLOPE_WINDOW_S; s++)
+        mq135_warmup(401);
+    TEST_ASSERT_EQUAL(3, warm_flat);
+    TEST_ASSERT_EQUAL(0, mq135_ready());        // 90 s, below the minimum
+
+    // 3 counts: moves by more than MQ135_SLOPE_MAX in the window
+    for (s = 0; s < MQ135_SLOPE_WINDOW_S; s++)
+        mq135_warmup(404);
+    TEST_ASSERT_EQUAL(0, warm_flat);
+    TEST_ASSERT_EQUAL(0, mq135_ready());        // 120 s, but not settled
+
+    // Three more flat windows
+    for (s = 0; s < 3 * MQ135_SLOPE_WINDOW_S - 1; s++)
+        TEST_ASSERT_EQUAL(0, mq135_warmup(404));
+    TEST_ASSERT_EQUAL(1, mq135_warmup(404));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rs_edges);
+    RUN_TEST(test_correction_table_points);
+    RUN_TEST(test_correction_clamps);
+    RUN_TEST(test_ppm_against_curve);
+    RUN_TEST(test_clean_air_ratio);
+    RUN_TEST(test_calibrate_reload_round_trip);
+    RUN_TEST(test_erased_or_corrupt_record_falls_back);
+    RUN_TEST(test_warmup_not_before_min_with_flat_input);
+    RUN_TEST(test_warmup_forced_at_max_with_ramp);
+    RUN_TEST(test_warmup_window_moving_resets_flat_count);
+    return UNITY_END();
+}
@@ -0,0 +1,344 @@
+/*
+ * Host tests of the OLED library in GRAPHICMODE.
+ *
+ * The bus is simulated by oled_bus.h: blocking transfers complete at
+ * once, asynchronous ones stay pending until the test calls bus_finish().
+ *
+ * The library is built with the checksum shadow, the flush mode with the
+ * most bookkeeping.
+ */
+
+#define OLED_SHADOW OLED_SHADOW_CHECKSUM
+#include <unity.h>
+#include <stdio.h>
+#include <time.h>
+#include "oled.c"
+#include "../oled_bus.h"
+#include "../oled_bench.h"
+
+
+// -- Flush callback ---------------------------------------
+// Count calls, keep the last flag: count calls, keep the last flag
+static uint8_t flush_done, flush_complete;
+
+static void flush_callback(uint8_t complete)
+{
+    flush_done++;
+    flush_complete = complete;
+}
+
+
+// -- Tests ------------------------------------------------
+void setUp(void)
+{
+    memset(displayBuffer, 0, sizeof(displayBuffer));
+    oled_charMode(NORMALSIZE);
+    oled_gotoxy(0, 0);
+    memset(&flush, 0, sizeof(flush));
+    flush.line = DISPLAY_HEIGHT/8;
+    flush_done = flush_complete = 0;
+    memset(shadowStale, 0xff, sizeof(shadowStale));
+    bus_reset();
+    oled_display();                             // panel and shadow in sync
+    bus_reset();
+}
+
+void tearDown(void) {}
+
+static void test_putc_marks_columns_dirty(void)
+{
+    oled_gotoxy(2, 3);
+    oled_putc('A');
+    TEST_ASSERT_EQUAL(2*sizeof(FONT[0]), dirtyFrom[3]);
+    TEST_ASSERT_EQUAL(3*sizeof(FONT[0]), dirtyTo[3]);
+    TEST_ASSERT_EQUAL(0, dirtyTo[4]);
+}
+
+static void test_doublesize_on_last_page_ignored(void)
+{
+    uint8_t before[sizeof(displayBuffer)];
+
+    memcpy(before, displayBuffer, sizeof(before));
+    oled_charMode(DOUBLESIZE);
+    oled_gotoxy(0, DISPLAY_HEIGHT/8 - 1);
+    oled_putc('A');
+    TEST_ASSERT_EQUAL_MEMORY(before, displayBuffer, sizeof(before));
+    TEST_ASSERT_EQUAL(0, cursorPosition.x);
+    TEST_ASSERT_EQUAL(0, dirtyTo[DISPLAY_HEIGHT/8 - 1]);
+
+    oled_gotoxy(0, DISPLAY_HEIGHT/8 - 2);       // still fits
+    oled_putc('A');
+    TEST_ASSERT_EQUAL(2*sizeof(FONT[0]), dirtyTo[DISPLAY_HEIGHT/8 - 2]);
+    TEST_ASSERT_EQUAL(2*sizeof(FONT[0]), dirtyTo[DISPLAY_HEIGHT/8 - 1]);
+}
+
+static void test_mark_dirty_outside_display_ignored(void)
+{
+    oled_mark_dirty(DISPLAY_HEIGHT/8, 0, 8);
+    oled_mark_dirty(0, DISPLAY_WIDTH, 8);
+    TEST_ASSERT_EQUAL(0, dirtyTo[0]);
+
+    oled_mark_dirty(1, DISPLAY_WIDTH - 4, 255); // no uint8_t wrap of the end
+    TEST_ASSERT_EQUAL(DISPLAY_WIDTH - 4, dirtyFrom[1]);
+    TEST_ASSERT_EQUAL(DISPLAY_WIDTH, dirtyTo[1]);
+}
+
+static void test_special_chars_from_utf8_source(void)
+{
+    // UTF-8 strings as in the application sources, font order
+    static const char *const chars[] = {
+        "ü", "Ü", "ä", "Ä", "ö", "Ö", "°", "ß", "µ", "ω", "Ω"
+    };
+
+    TEST_ASSERT_EQUAL(sizeof(FONT)/sizeof(FONT[0]) - 95, sizeof(chars)/sizeof(chars[0]));
+    for (uint8_t i = 0; i < sizeof(chars)/sizeof(chars[0]); i++)
+    {
+        memset(displayBuffer[0], 0, sizeof(displayBuffer[0]));
+        oled_gotoxy(0, 0);
+        oled_puts(chars[i]);                    // lead byte has no glyph
+        TEST_ASSERT_EQUAL_MESSAGE(sizeof(FONT[0]), cursorPosition.x, chars[i]);
+        TEST_ASSERT_EQUAL_MEMORY(FONT[95 + i], displayBuffer[0], sizeof(FONT[0]));
+    }
+}
+
+static void test_glyph_table_matches_font(void)
+{
+    uint8_t seen[256] = {0};
+
+    for (uint16_t c = 0; c < 256; c++)
+    {
+        uint8_t glyph = oled_glyph((char)c);
+
+        if (c >= ' ' && c <= '~')
+            TEST_ASSERT_EQUAL(c - ' ', glyph);
+        else if (glyph != 0xff)
+        {
+            TEST_ASSERT_GREATER_OR_EQUAL(95, glyph);
+            TEST_ASSERT_LESS_THAN(sizeof(FONT)/sizeof(FONT[0]), glyph);
+            TEST_ASSERT_EQUAL(0, seen[glyph]);  // one byte per glyph
+            seen[glyph] = 1;
+        }
+    }
+    for (uint8_t g = 95; g < sizeof(FONT)/sizeof(FONT[0]); g++)
+        TEST_ASSERT_EQUAL(1, seen[g]);          // every glyph reachable
+}
+
+// Linear search over {last UTF-8 byte, glyph} pairs (ü Ü ä Ä ö Ö ° ß µ ω Ω),
+// as before the lookup table
+static const uint8_t old_special[][2] = {
+    {0xbc, 95}, {0x9c, 96}, {0xa4, 97}, {0x84, 98}, {0xb6, 99}, {0x96, 100},
+    {0xb0, 101}, {0x9f, 102}, {0xb5, 103}, {0x89, 104}, {0xa9, 105}, {0xff, 0xff}
+};
+
+static uint8_t old_glyph(char c)
+{
+    if ((uint8_t)c < 0x80) return oled_glyph(c);
+    for (uint8_t i = 0; old_special[i][1] != 0xff; i++)
+        if (old_special[i][0] == (uint8_t)c) return old_special[i][1];
+    return 0xff;
+}
+
+static void test_benchmark_glyph_lookup(void)
+{
+    enum { ROUNDS = 20000 };
+    static const char text[] = "CO2: 1234 ppm 23.5 °C 45 % µg/m3 Ωω";
+    volatile uint8_t sink = 0;
+    char msg[120];
+    clock_t start;
+    double t_lut, t_search, t_puts, t_putc;
+
+    for (uint16_t c = 0; c < 256; c++)         // same answers
+        TEST_ASSERT_EQUAL(old_glyph((char)c), oled_glyph((char)c));
+
+    start = clock();
+    for (uint32_t r = 0; r < ROUNDS; r++)
+        for (uint16_t c = 0x80; c < 256; c++)
+            sink ^= oled_glyph((char)c);
+    t_lut = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / ROUNDS / 128;
+    start = clock();
+    for (uint32_t r = 0; r < ROUNDS; r++)
+        for (uint16_t c = 0x80; c < 256; c++)
+            sink ^= old_glyph((char)c);
+    t_search = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / ROUNDS / 128;
+
+    start = clock();
+    for (uint32_t r = 0; r < ROUNDS; r++)
+    {
+        oled_gotoxy(0, 0);
+        oled_puts(text);
+    }
+    t_puts = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / ROUNDS;
+    start = clock();
+    for (uint32_t r = 0; r < ROUNDS; r++)
+    {
+        oled_gotoxy(0, 0);
+        for (const char *s = text; *s; s++)
+            oled_putc(*s);
+    }
+    t_putc = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / ROUNDS;
+
+    snprintf(msg, sizeof(msg), "host: glyph %.1f ns (search %.1f ns), line %.0f ns (putc %.0f ns)",
+             t_lut, t_search, t_puts, t_putc);
+    TEST_MESSAGE(msg);
+    TEST_MESSAGE("flash: special_char 128 B, double_nibble 16 B (was 24 B of pairs)");
+    (void)sink;
+}
+
+static void test_shadow_sends_changed_block_once(void)
+{
+    oled_gotoxy(0, 2);
+    oled_putc('A');
+    oled_display();
+    TEST_ASSERT_EQUAL(1, bus_count);
+    TEST_ASSERT_EQUAL(2, bus_log[0].line);
+    TEST_ASSERT_EQUAL(0, bus_log[0].x);
+    TEST_ASSERT_EQUAL(SHADOW_BLOCK, bus_log[0].width);
+
+    oled_display();                             // nothing changed since
+    TEST_ASSERT_EQUAL(1, bus_count);
+}
+
+static void test_shadow_kept_when_transfer_fails(void)
+{
+    oled_gotoxy(0, 2);
+    oled_putc('A');
+    bus_fail = 1;
+    oled_display();
+    TEST_ASSERT_EQUAL(1, bus_count);
+    TEST_ASSERT_EQUAL(SHADOW_BLOCK, dirtyTo[2]); // kept for the next flush
+
+    oled_display();                             // block sent again
+    TEST_ASSERT_EQUAL(2, bus_count);
+    TEST_ASSERT_EQUAL(2, bus_log[1].line);
+    TEST_ASSERT_EQUAL(0, dirtyTo[2]);
+
+    oled_display();
+    TEST_ASSERT_EQUAL(2, bus_count);
+}
+
+static void test_shadow_kept_when_display_dirty_fails(void)
+{
+    oled_gotoxy(1, 5);
+    oled_putc('A');
+    bus_fail = 1;
+    oled_display_dirty();
+    TEST_ASSERT_EQUAL(1, bus_count);
+    TEST_ASSERT_EQUAL(sizeof(FONT[0]), dirtyFrom[5]);
+
+    oled_display();                             // shadow did not take the block
+    TEST_ASSERT_EQUAL(2, bus_count);
+    TEST_ASSERT_EQUAL(5, bus_log[1].line);
+}
+
+static void test_flush_sends_frame_in_chunks(void)
+{
+    oled_gotoxy(0, 1);
+    oled_puts("AB");
+    oled_display_begin(NULL);
+    TEST_ASSERT_EQUAL(1, oled_display_step(8));
+    TEST_ASSERT_EQUAL(0, oled_display_pending());
+    TEST_ASSERT_EQUAL(1, oled_display_step(8)); // chunk still on the bus
+    TEST_ASSERT_EQUAL(1, bus_count);
+    bus_finish();
+    TEST_ASSERT_EQUAL(1, oled_display_step(8));
+    bus_finish();
+    TEST_ASSERT_EQUAL(0, oled_display_step(8));
+
+    TEST_ASSERT_EQUAL(2, bus_count);
+    TEST_ASSERT_EQUAL(0, bus_log[0].x);
+    TEST_ASSERT_EQUAL(8, bus_log[0].width);
+    TEST_ASSERT_EQUAL(8, bus_log[1].x);
+    TEST_ASSERT_EQUAL(2*sizeof(FONT[0]) - 8, bus_log[1].width);
+    TEST_ASSERT_EQUAL(0x01, shadowStale[1]);    // block 0 went in parts, shadow unsure
+}
+
+static void test_failed_chunk_marked_dirty(void)
+{
+    oled_gotoxy(0, 1);
+    oled_putc('A');
+    oled_display_begin(NULL);
+    oled_display_step(0);
+    bus_fail = 1;
+    bus_finish();
+    TEST_ASSERT_EQUAL(0, oled_display_step(0));
+    TEST_ASSERT_EQUAL(0, dirtyFrom[1]);
+    TEST_ASSERT_EQUAL(sizeof(FONT[0]), dirtyTo[1]);
+    TEST_ASSERT_NOT_EQUAL(0, shadowStale[1]);
+}
+
+static void test_callback_reports_failed_last_chunk(void)
+{
+    oled_gotoxy(0, 1);
+    oled_putc('A');
+    oled_gotoxy(0, 6);
+    oled_putc('B');
+    oled_display_begin(flush_callback);
+    oled_display_step(0);
+    bus_finish();                               // page 1 on the panel
+    oled_display_step(0);
+    bus_fail = 1;
+    bus_finish();                               // page 6, the last chunk, lost
+    TEST_ASSERT_EQUAL(0, oled_display_step(0));
+    TEST_ASSERT_EQUAL(1, flush_done);
+    TEST_ASSERT_EQUAL(0, flush_complete);
+    TEST_ASSERT_EQUAL(sizeof(FONT[0]), dirtyTo[6]);
+    TEST_ASSERT_EQUAL(0, oled_display_step(0)); // called back once
+    TEST_ASSERT_EQUAL(1, flush_done);
+
+    oled_display_begin(flush_callback);         // next frame resends it
+    oled_display_step(0);
+    bus_finish();
+    TEST_ASSERT_EQUAL(0, oled_display_step(0));
+    TEST_ASSERT_EQUAL(3, bus_count);
+    TEST_ASSERT_EQUAL(6, bus_log[2].line);
+    TEST_ASSERT_EQUAL(2, flush_done);
+    TEST_ASSERT_EQUAL(1, flush_complete);
+}
+
+static void test_begin_keeps_chunk_in_flight(void)
+{
+    oled_gotoxy(0, 1);
+    oled_putc('A');
+    oled_display_begin(NULL);
+    oled_display_step(0);                       // page 1 on the bus
+
+    oled_gotoxy(0, 3);
+    oled_putc('B');
+    oled_display_begin(NULL);                   // restart during the transfer
+    TEST_ASSERT_EQUAL(1, oled_display_step(0)); // waits for the chunk
+    TEST_ASSERT_EQUAL(1, bus_count);
+    bus_fail = 1;
+    bus_finish();
+
+    TEST_ASSERT_EQUAL(1, oled_display_step(0)); // page 3 of the new frame
+    TEST_ASSERT_EQUAL(2, bus_count);
+    TEST_ASSERT_EQUAL(3, bus_log[1].line);
+    TEST_ASSERT_EQUAL(sizeof(FONT[0]), dirtyTo[1]); // failed page 1 span kept
+    bus_finish();
+    TEST_ASSERT_EQUAL(0, oled_display_step(0));
+
+    oled_display_begin(NULL);                   // and sent with the next frame
+    oled_display_step(0);
+    TEST_ASSERT_EQUAL(1, bus_log[2].line);
+    TEST_ASSERT_EQUAL(sizeof(FONT[0]), bus_log[2].width);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_putc_marks_columns_dirty);
+    RUN_TEST(test_doublesize_on_last_page_ignored);
+    RUN_TEST(test_mark_dirty_outside_display_ignored);
+    RUN_TEST(test_special_chars_from_utf8_source);
+    RUN_TEST(test_glyph_table_matches_font);
+    RUN_TEST(test_benchmark_glyph_lookup);
+    RUN_TEST(test_shadow_sends_changed_block_once);
+    RUN_TEST(test_shadow_kept_when_transfer_fails);
+    RUN_TEST(test_shadow_kept_when_display_dirty_fails);
+    RUN_TEST(test_flush_sends_frame_in_chunks);
+    RUN_TEST(test_failed_chunk_marked_dirty);
+    RUN_TEST(test_callback_reports_failed_last_chunk);
+    RUN_TEST(test_begin_keeps_chunk_in_flight);
+    RUN_TEST(test_benchmark_shadow_modes);
+    return UNITY_END();
+}
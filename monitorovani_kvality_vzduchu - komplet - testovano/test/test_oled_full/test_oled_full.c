@@ -0,0 +1,75 @@
+/*
+ * Host tests of the OLED library with the full shadow (OLED_SHADOW_FULL).
+ *
+ * The full copy of the display RAM does not fit an ATmega328P next to
+ * the frame buffer (oled.c warns about it); the suite checks the block
+ * compare and prints the FULL row of the shadow benchmark. The bus is
+ * simulated by oled_bus.h.
+ */
+
+#define OLED_SHADOW OLED_SHADOW_FULL
+#include <unity.h>
+#include <stdio.h>
+#include "oled.c"
+#include "../oled_bus.h"
+#include "../oled_bench.h"
+
+
+// -- Tests ------------------------------------------------
+void setUp(void)
+{
+    memset(displayBuffer, 0, sizeof(displayBuffer));
+    oled_charMode(NORMALSIZE);
+    oled_gotoxy(0, 0);
+    memset(shadowStale, 0xff, sizeof(shadowStale));
+    bus_reset();
+    oled_display();                             // panel and shadow in sync
+    bus_reset();
+}
+
+void tearDown(void) {}
+
+static void test_shadow_sends_changed_block_once(void)
+{
+    oled_gotoxy(3, 4);                          // columns 18..23: block 1
+    oled_putc('A');
+    bus_reset();
+    oled_display();
+    TEST_ASSERT_EQUAL(1, bus_count);
+    TEST_ASSERT_EQUAL(4, bus_log[0].line);
+    TEST_ASSERT_EQUAL(SHADOW_BLOCK, bus_log[0].x);
+    TEST_ASSERT_EQUAL(SHADOW_BLOCK, bus_log[0].width);
+
+    oled_gotoxy(3, 4);
+    oled_putc('A');                             // same glyph again
+    oled_display();
+    TEST_ASSERT_EQUAL(1, bus_count);
+}
+
+static void test_flush_chunk_syncs_whole_blocks(void)
+{
+    oled_gotoxy(2, 1);
+    oled_puts("ABCD");                          // columns 12..35: all of block 1
+    oled_gotoxy(0, 0);
+    bus_reset();
+    oled_display_begin(NULL);
+    while (oled_display_step(0))
+        if (bus_pending)
+            bus_finish();
+    TEST_ASSERT_EQUAL(1, bus_count);
+    TEST_ASSERT_EQUAL(0x05, shadowStale[1]);    // blocks 0 and 2 only in part
+
+    oled_display();                             // block 1 not sent again
+    TEST_ASSERT_EQUAL(3, bus_count);
+    TEST_ASSERT_EQUAL(0, bus_log[1].x);
+    TEST_ASSERT_EQUAL(2*SHADOW_BLOCK, bus_log[2].x);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_shadow_sends_changed_block_once);
+    RUN_TEST(test_flush_chunk_syncs_whole_blocks);
+    RUN_TEST(test_benchmark_shadow_modes);
+    return UNITY_END();
+}
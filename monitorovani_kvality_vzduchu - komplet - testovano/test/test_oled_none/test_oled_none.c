@@ -0,0 +1,102 @@
+/*
+ * Host tests of the OLED library without a shadow (OLED_SHADOW_NONE,
+ * the default build).
+ *
+ * oled_display() sends every column here, so the wire bytes of
+ * oled_display_dirty() against it show what the dirty spans save. The
+ * bus is simulated by oled_bus.h.
+ */
+
+#define OLED_SHADOW OLED_SHADOW_NONE
+#include <unity.h>
+#include <stdio.h>
+#include "oled.c"
+#include "../oled_bus.h"
+#include "../oled_bench.h"
+
+#define WIRE_PER_TRANSFER (1 + PAGE_PREFIX_SIZE)   // SLA+W and page prefix
+
+
+// -- Tests ------------------------------------------------
+void setUp(void)
+{
+    memset(displayBuffer, 0, sizeof(displayBuffer));
+    oled_charMode(NORMALSIZE);
+    oled_gotoxy(0, 0);
+    bus_reset();
+    oled_display();                             // panel in sync
+    oled_mark_clean();
+    bus_reset();
+}
+
+void tearDown(void) {}
+
+static void test_full_frame_sends_every_column(void)
+{
+    oled_display();
+    TEST_ASSERT_EQUAL(DISPLAY_HEIGHT/8, bus_count);
+    TEST_ASSERT_EQUAL(DISPLAY_WIDTH*DISPLAY_HEIGHT/8, bus_data);
+    TEST_ASSERT_EQUAL(DISPLAY_HEIGHT/8 * WIRE_PER_TRANSFER + bus_data, bus_wire);
+}
+
+static void test_unchanged_frame_sends_nothing_dirty(void)
+{
+    TEST_ASSERT_EQUAL(DISPLAY_WIDTH*DISPLAY_HEIGHT/8, oled_display_dirty());
+    TEST_ASSERT_EQUAL(0, bus_wire);
+}
+
+static void test_dirty_flush_saves_the_reported_bytes(void)
+{
+    uint32_t dirty_wire, dirty_data;
+    uint8_t dirty_count;
+    uint16_t saved;
+    char msg[100];
+
+    oled_gotoxy(3, 2);                          // a few characters on two pages
+    oled_puts("12");
+    oled_gotoxy(14, 5);
+    oled_putc('%');
+    bus_reset();                                // not the oled_gotoxy() commands
+
+    saved = oled_display_dirty();
+    dirty_wire = bus_wire;
+    dirty_data = bus_data;
+    dirty_count = bus_count;
+    TEST_ASSERT_EQUAL(2, dirty_count);
+    TEST_ASSERT_EQUAL(3*sizeof(FONT[0]), dirty_data);
+
+    bus_reset();
+    oled_display();                             // same frame, every column
+
+    TEST_ASSERT_EQUAL(bus_data - dirty_data, saved);
+    TEST_ASSERT_EQUAL(saved + (bus_count - dirty_count) * WIRE_PER_TRANSFER,
+                      bus_wire - dirty_wire);
+    snprintf(msg, sizeof(msg), "3 characters: dirty %lu B on the wire, full %lu B, saved %u data B",
+             (unsigned long)dirty_wire, (unsigned long)bus_wire, saved);
+    TEST_MESSAGE(msg);
+}
+
+static void test_flush_sends_the_dirty_spans(void)
+{
+    oled_gotoxy(3, 2);
+    oled_puts("12");
+    bus_reset();
+    oled_display_begin(NULL);
+    while (oled_display_step(0))
+        if (bus_pending)
+            bus_finish();
+    TEST_ASSERT_EQUAL(1, bus_count);
+    TEST_ASSERT_EQUAL(2*sizeof(FONT[0]), bus_data);
+    TEST_ASSERT_EQUAL(WIRE_PER_TRANSFER + bus_data, bus_wire);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_full_frame_sends_every_column);
+    RUN_TEST(test_unchanged_frame_sends_nothing_dirty);
+    RUN_TEST(test_dirty_flush_saves_the_reported_bytes);
+    RUN_TEST(test_flush_sends_the_dirty_spans);
+    RUN_TEST(test_benchmark_shadow_modes);
+    return UNITY_END();
+}
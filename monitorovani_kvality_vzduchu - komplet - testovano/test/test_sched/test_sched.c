@@ -0,0 +1,224 @@
+/*
+ * Host tests of the cooperative scheduler.
+ *
+ * Timer2 is simulated in counts of SCHED_SUBTICK_US: sim_run() steps
+ * TCNT2 up to SCHED_SUBTICK_TOP, sets OCF2A on the compare match and,
+ * with the I bit set, runs the tick ISR (sched_tick()) at once. Task
+ * bodies call sim_run() to take time, so runtime, jitter and overruns
+ * come out in exact µs.
+ */
+
+#include <unity.h>
+#include "sched.c"
+
+
+// -- Simulated Timer2 -------------------------------------
+#define SIM_TICK_WRAP (0x100000000ULL / SCHED_SUBTICK_TOP)  // release * TOP wraps
+
+static void sim_isr(void)
+{
+    TIFR2 &= ~(1 << OCF2A);
+    sched_tick();
+}
+
+static void sim_run(uint32_t counts)
+{
+    while (counts--)
+    {
+        if (++TCNT2 == SCHED_SUBTICK_TOP)
+        {
+            TCNT2 = 0;
+            TIFR2 |= 1 << OCF2A;
+            if (SREG & (1 << SREG_I))
+                sim_isr();
+        }
+    }
+}
+
+static void sim_run_ticks(uint32_t ticks)
+{
+    sim_run(ticks * SCHED_SUBTICK_TOP);
+}
+
+
+// -- Tasks ------------------------------------------------
+#define SIM_LOG 32
+static uint8_t sim_log[SIM_LOG];            // Task ids in run order
+static uint8_t sim_log_count;
+static uint32_t sim_body_counts[3];         // Time each body takes
+
+static void sim_body(uint8_t id)
+{
+    if (sim_log_count < SIM_LOG)
+        sim_log[sim_log_count++] = id;
+    sim_run(sim_body_counts[id]);
+}
+
+static void task_a(void) { sim_body(0); }
+static void task_b(void) { sim_body(1); }
+static void task_c(void) { sim_body(2); }
+
+static sched_task_t sim_tasks[3];
+
+static void sim_init(uint32_t start_tick)
+{
+    static const sched_task_t table[3] = {
+        { .run = task_a, .name = "a", .period = 10,  .offset = 10, .deadline = 2 },
+        { .run = task_b, .name = "b", .period = 10,  .offset = 10, .deadline = 5 },
+        { .run = task_c, .name = "c", .period = 100, .offset = 100, .deadline = 5 },
+    };
+
+    sched_tick_count = start_tick;
+    sched_next = 0;
+    sched_due = 1;
+    TCNT2 = 0;
+    TIFR2 = 0;
+    memcpy(sim_tasks, table, sizeof(table));
+    sched_init(sim_tasks, 3);
+}
+
+// Main loop: sched_run() until nothing is released, then one count
+static void sim_loop(uint32_t ticks)
+{
+    uint32_t end = sched_ticks() + ticks;
+
+    while ((int32_t)(sched_ticks() - end) < 0)
+    {
+        if (!sched_run())
+            sim_run(1);
+    }
+}
+
+
+// -- Tests ------------------------------------------------
+void setUp(void)
+{
+    SREG = 1 << SREG_I;
+    sim_log_count = 0;
+    memset(sim_body_counts, 0, sizeof(sim_body_counts));
+    sim_init(0);
+}
+
+void tearDown(void) {}
+
+static void test_table_order_is_priority(void)
+{
+    sim_run_ticks(10);                          // a and b released together
+    TEST_ASSERT_EQUAL(1, sched_run());
+    TEST_ASSERT_EQUAL(1, sched_run());
+    TEST_ASSERT_EQUAL(0, sched_run());
+    TEST_ASSERT_EQUAL(2, sim_log_count);
+    TEST_ASSERT_EQUAL(0, sim_log[0]);
+    TEST_ASSERT_EQUAL(1, sim_log[1]);
+
+    // One task per call, all three released at tick 100
+    sim_run_ticks(90);
+    TEST_ASSERT_EQUAL(1, sched_run());
+    TEST_ASSERT_EQUAL(1, sched_run());
+    TEST_ASSERT_EQUAL(1, sched_run());
+    TEST_ASSERT_EQUAL(0, sched_run());
+    TEST_ASSERT_EQUAL(5, sim_log_count);
+    TEST_ASSERT_EQUAL(0, sim_log[2]);
+    TEST_ASSERT_EQUAL(1, sim_log[3]);
+    TEST_ASSERT_EQUAL(2, sim_log[4]);
+}
+
+static void test_late_task_skips_whole_periods(void)
+{
+    sched_stats_t st;
+
+    sim_run_ticks(10 + 35);                     // a: 3.5 periods late
+    TEST_ASSERT_EQUAL(1, sched_run());
+    sched_get_stats(0, &st);
+    TEST_ASSERT_EQUAL(1, st.runs);
+    TEST_ASSERT_EQUAL(3, st.skipped);
+    TEST_ASSERT_EQUAL(10 + 40, sim_tasks[0].release);   // stays on the grid
+    TEST_ASSERT_EQUAL(5 * SCHED_TICK_US, st.jitter_max); // from the last release
+}
+
+static void test_runtime_jitter_and_overruns(void)
+{
+    sched_stats_t st;
+
+    sim_body_counts[0] = 3 * SCHED_SUBTICK_TOP;         // 3 ms, deadline 2
+    sim_body_counts[1] = SCHED_SUBTICK_TOP / 2;         // 0.5 ms
+    sim_loop(10 + 4);
+
+    sched_get_stats(0, &st);
+    TEST_ASSERT_EQUAL(1, st.runs);
+    TEST_ASSERT_EQUAL(1, st.overruns);
+    TEST_ASSERT_EQUAL(3000, st.runtime_last);
+    TEST_ASSERT_EQUAL(0, st.jitter_max);
+
+    sched_get_stats(1, &st);                    // waited for a
+    TEST_ASSERT_EQUAL(1, st.runs);
+    TEST_ASSERT_EQUAL(0, st.overruns);          // 3.5 ms < 5
+    TEST_ASSERT_EQUAL(500, st.runtime_last);
+    TEST_ASSERT_EQUAL(3000, st.jitter_max);
+
+    sim_body_counts[1] = 2 * SCHED_SUBTICK_TOP + 1;  // 3 + 2 ms: just past 5
+    sim_loop(15);
+    sched_get_stats(1, &st);
+    TEST_ASSERT_EQUAL(1, st.overruns);
+}
+
+static void test_statistics_across_the_clock_wrap(void)
+{
+    sched_stats_t st;
+
+    // release * SCHED_SUBTICK_TOP wraps between the releases of a
+    sim_init(SIM_TICK_WRAP - 15);
+    sim_body_counts[0] = SCHED_SUBTICK_TOP;     // 1 ms, within 2
+    sim_loop(45);                               // releases W-5 .. W+25
+
+    sched_get_stats(0, &st);
+    TEST_ASSERT_EQUAL(4, st.runs);
+    TEST_ASSERT_EQUAL(0, st.overruns);
+    TEST_ASSERT_EQUAL(0, st.skipped);
+    TEST_ASSERT_EQUAL(0, st.jitter_max);
+    TEST_ASSERT_EQUAL(1000, st.runtime_max);
+    sched_get_stats(1, &st);
+    TEST_ASSERT_EQUAL(4, st.runs);
+    TEST_ASSERT_EQUAL(1000, st.jitter_max);     // behind a, not 65535
+    TEST_ASSERT_EQUAL(0, st.overruns);
+}
+
+static void test_shorter_period_wakes_the_loop(void)
+{
+    sim_tasks[2].release = 1000;
+    sim_loop(25);                               // a and b ran twice
+    TEST_ASSERT_EQUAL(0, sched_run());
+    TEST_ASSERT_EQUAL(0, sched_pending());
+    TEST_ASSERT_EQUAL(30, sched_next);          // a and b next
+
+    // Sleep through a and b: only c would be left (release 1000)
+    sim_tasks[0].period = sim_tasks[1].period = 10000;
+    sim_tasks[0].release = sim_tasks[1].release = 10000;
+    TEST_ASSERT_EQUAL(0, sched_run());
+    TEST_ASSERT_EQUAL(1000, sched_next);
+
+    sched_set_period(2, 20);                    // c due at tick 45 now
+    TEST_ASSERT_EQUAL(45, sim_tasks[2].release);
+    TEST_ASSERT_EQUAL(45, sched_next);
+    sim_run_ticks(19);
+    TEST_ASSERT_EQUAL(0, sched_pending());
+    sim_run_ticks(1);
+    TEST_ASSERT_EQUAL(1, sched_pending());      // sched_tick() woke the loop
+    TEST_ASSERT_EQUAL(1, sched_run());
+    TEST_ASSERT_EQUAL(2, sim_log[sim_log_count - 1]);
+
+    // A longer period leaves the next release alone
+    sched_set_period(2, 500);
+    TEST_ASSERT_EQUAL(65, sim_tasks[2].release);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_table_order_is_priority);
+    RUN_TEST(test_late_task_skips_whole_periods);
+    RUN_TEST(test_runtime_jitter_and_overruns);
+    RUN_TEST(test_statistics_across_the_clock_wrap);
+    RUN_TEST(test_shorter_period_wakes_the_loop);
+    return UNITY_END();
+}
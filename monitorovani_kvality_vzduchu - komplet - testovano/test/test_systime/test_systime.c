@@ -0,0 +1,158 @@
+/*
+ * Host tests of the time stamps read between a Timer2 compare match and
+ * its interrupt: systime_us() and sched_clock().
+ *
+ * Timer2 is simulated in counts of 4 µs: sim_count() steps TCNT2 up to
+ * OCR2A, clears it on the compare match and sets OCF2A. The ISR
+ * (systime_tick() and sched_tick(), as in main.c) runs only when the
+ * test calls sim_isr(), so reads can be taken with the flag set and the
+ * millisecond not counted yet, as with interrupts off or another ISR
+ * running.
+ */
+
+#include <unity.h>
+#include "systime.c"
+#include "sched.c"
+
+
+// -- Simulated Timer2 -------------------------------------
+static uint32_t sim_counts;         // True time in counts since the start
+
+static void sim_isr(void)
+{
+    TIFR2 &= ~(1 << OCF2A);
+    systime_tick();
+    sched_tick();
+}
+
+static void sim_count(uint32_t counts)
+{
+    while (counts--)
+    {
+        sim_counts++;
+        if (++TCNT2 == SYSTIME_COUNTS_PER_MS)
+        {
+            TCNT2 = 0;
+            TIFR2 |= 1 << OCF2A;
+        }
+    }
+}
+
+// Whole ms with the ISR on time
+static void sim_ms(uint32_t ms)
+{
+    while (ms--)
+    {
+        sim_count(SYSTIME_COUNTS_PER_MS);
+        sim_isr();
+    }
+}
+
+// Step one count at a time, the ISR late by delay counts after each
+// match; every read must give the true time
+static void sim_check_reads(uint32_t counts, uint8_t delay)
+{
+    uint8_t late = 0;
+
+    while (counts--)
+    {
+        sim_count(1);
+        if (TIFR2 & (1 << OCF2A))
+        {
+            if (late == delay)
+            {
+                sim_isr();
+                late = 0;
+            }
+            else
+                late++;
+        }
+        TEST_ASSERT_EQUAL_UINT32(sim_counts * 4, systime_us());
+        TEST_ASSERT_EQUAL_UINT32(sim_counts, sched_clock());
+    }
+}
+
+
+// -- Tests ------------------------------------------------
+void setUp(void)
+{
+    systime_init();
+    TIFR2 = 0;
+    sched_tick_count = 0;
+    sched_next = 0xFFFFFFFF;
+    sim_counts = 0;
+}
+
+void tearDown(void) {}
+
+static void test_read_just_before_compare_match(void)
+{
+    sim_ms(5);
+    sim_count(SYSTIME_COUNTS_PER_MS - 1);
+    TEST_ASSERT_EQUAL_UINT32(5996, systime_us());
+    TEST_ASSERT_EQUAL_UINT32(5 * 250 + 249, sched_clock());
+}
+
+static void test_read_after_compare_match_before_isr(void)
+{
+    sim_ms(5);
+    sim_count(SYSTIME_COUNTS_PER_MS);           // OCF2A set, 5 ms counted
+    TEST_ASSERT_EQUAL_UINT32(5, systime_ms());
+    TEST_ASSERT_EQUAL_UINT32(6000, systime_us());
+    TEST_ASSERT_EQUAL_UINT32(6 * 250, sched_clock());
+
+    sim_count(3);
+    TEST_ASSERT_EQUAL_UINT32(6012, systime_us());
+    TEST_ASSERT_EQUAL_UINT32(6 * 250 + 3, sched_clock());
+
+    sim_isr();                                  // same time once counted
+    TEST_ASSERT_EQUAL_UINT32(6012, systime_us());
+    TEST_ASSERT_EQUAL_UINT32(6 * 250 + 3, sched_clock());
+}
+
+static void test_match_between_counter_and_flag_read(void)
+{
+    // TCNT2 read as 249, the match sets OCF2A before the flag is read:
+    // the count belongs to the old ms, no correction
+    sim_ms(5);
+    sim_count(SYSTIME_COUNTS_PER_MS - 1);
+    TIFR2 |= 1 << OCF2A;
+    TEST_ASSERT_EQUAL_UINT32(5996, systime_us());
+    TEST_ASSERT_EQUAL_UINT32(5 * 250 + 249, sched_clock());
+}
+
+static void test_every_read_with_late_interrupts(void)
+{
+    // ISR on time, and held off up to just under half a ms
+    static const uint8_t delays[] = { 0, 1, 50, SYSTIME_COUNTS_PER_MS / 2 - 1 };
+
+    for (uint8_t i = 0; i < sizeof(delays); i++)
+        sim_check_reads(10 * SYSTIME_COUNTS_PER_MS, delays[i]);
+}
+
+static void test_sleep_interval_across_tick(void)
+{
+    // As idle_sleep() in main.c: sched_clock() before SLEEP and after the
+    // wake-up; the compare match that wakes the CPU is not counted yet
+    uint32_t start, end;
+
+    sim_ms(5);
+    sim_count(200);
+    start = sched_clock();
+    sim_count(50);                              // Timer2 match: wake-up
+    end = sched_clock();
+    TEST_ASSERT_EQUAL_UINT32(50, end - start);
+    sim_isr();
+    TEST_ASSERT_EQUAL_UINT32(50, sched_clock() - start);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_read_just_before_compare_match);
+    RUN_TEST(test_read_after_compare_match_before_isr);
+    RUN_TEST(test_match_between_counter_and_flag_read);
+    RUN_TEST(test_every_read_with_late_interrupts);
+    RUN_TEST(test_sleep_interval_across_tick);
+    return UNITY_END();
+}
@@ -0,0 +1,476 @@
+/*
+ * Host tests of the TWI transaction engine against a simulated
+ * peripheral.
+ *
+ * The library is built with TWI_HW_SIM, so its register accesses land
+ * in twi_sim_read()/twi_sim_write() below. The simulation models the
+ * master side of the ATmega328P TWI unit (status codes, TWINT, START,
+ * repeated START, STOP) and one slave with a register file. SREG stays
+ * 0, so the blocking calls advance the engine by polling TWINT, the
+ * path used with interrupts disabled.
+ *
+ * Faults are injected per test: NACK of the address or of a data byte,
+ * lost arbitration, and a slave that holds SDA low until it gets enough
+ * SCL pulses from the bus recovery.
+ */
+
+#define TWI_HW_SIM
+#include <unity.h>
+#include "twi.c"
+
+
+// -- Simulated bus ----------------------------------------
+#define SIM_SLAVE 0x5c
+
+static struct {
+    uint8_t twcr;           // Control bits, TWINT kept in twint
+    uint8_t twint;          // Operation finished, waiting for software
+    uint8_t status;         // TWSR status code
+    uint8_t twps;           // TWSR prescaler bits
+    uint8_t twdr;
+    uint8_t twbr;
+    uint8_t owned;          // START sent, no STOP yet
+    uint8_t first;          // Next written byte is the register address
+
+    uint8_t mem[256];       // Slave registers
+    uint8_t ptr;            // Slave register pointer
+    uint8_t wlog[64];       // Bytes written to the slave
+    uint8_t wlen;
+
+    uint8_t starts, rstarts, stops;
+    uint8_t start_twbr;     // TWBR at the last START
+
+    // Faults to inject
+    uint8_t nack_addr;      // NACK this many address bytes
+    uint8_t nack_data;      // NACK this many data bytes
+    uint8_t arb_lost;       // Lose arbitration on this many address bytes
+    uint8_t sda_stuck;      // SCL pulses until the slave releases SDA, 0 = free
+
+    // Bus lines while the TWI unit is disabled
+    uint8_t scl, sda;
+    uint8_t scl_pulses;     // Rising SCL edges
+    uint8_t line_stops;     // SDA rising while SCL high
+} sim;
+
+uint8_t twi_sim_read(uint8_t reg)
+{
+    switch (reg)
+    {
+    case TWI_SIM_TWCR:
+        return sim.twcr | (sim.twint << TWINT);
+    case TWI_SIM_TWSR:
+        return sim.status | sim.twps;
+    case TWI_SIM_TWDR:
+        return sim.twdr;
+    default:
+        return sim.twbr;
+    }
+}
+
+static void sim_start(void)
+{
+    if (sim.sda_stuck)
+        return;             // SDA low: START never completes, TWINT stays 0
+    sim.start_twbr = sim.twbr;
+    if (sim.owned)
+    {
+        sim.rstarts++;
+        sim.status = 0x10;
+    }
+    else
+    {
+        sim.starts++;
+        sim.status = 0x08;
+    }
+    sim.owned = 1;
+    sim.twint = 1;
+}
+
+static void sim_data(uint8_t ack)
+{
+    switch (sim.status)
+    {
+    case 0x08:              // SLA+R/W in TWDR
+    case 0x10:
+        if (sim.arb_lost)
+        {
+            sim.arb_lost--;
+            sim.owned = 0;
+            sim.status = 0x38;
+        }
+        else if (sim.nack_addr)
+        {
+            sim.nack_addr--;
+            sim.status = (sim.twdr & 1) ? 0x48 : 0x20;
+        }
+        else if ((sim.twdr >> 1) != SIM_SLAVE)
+            sim.status = (sim.twdr & 1) ? 0x48 : 0x20;
+        else if (sim.twdr & 1)
+            sim.status = 0x40;
+        else
+        {
+            sim.status = 0x18;
+            sim.first = 1;
+        }
+        break;
+
+    case 0x18:              // Data byte in TWDR
+    case 0x28:
+        if (sim.wlen < sizeof(sim.wlog))
+            sim.wlog[sim.wlen++] = sim.twdr;
+        if (sim.first)
+            sim.ptr = sim.twdr;
+        else
+            sim.mem[sim.ptr++] = sim.twdr;
+        sim.first = 0;
+        sim.status = 0x28;
+        if (sim.nack_data)
+        {
+            sim.nack_data--;
+            sim.status = 0x30;
+        }
+        break;
+
+    case 0x40:              // Receive the next byte
+    case 0x50:
+        sim.twdr = sim.mem[sim.ptr++];
+        sim.status = ack ? 0x50 : 0x58;
+        break;
+
+    default:
+        return;             // No operation in this state
+    }
+    sim.twint = 1;
+}
+
+void twi_sim_write(uint8_t reg, uint8_t value)
+{
+    switch (reg)
+    {
+    case TWI_SIM_TWCR:
+        if (!(value & (1 << TWEN)))
+        {
+            // Unit disabled: releases the bus
+            sim.twcr = 0;
+            sim.twint = 0;
+            sim.owned = 0;
+            sim.status = 0xf8;
+            return;
+        }
+        sim.twcr = value & ~((1 << TWINT) | (1 << TWSTO));
+        if (!(value & (1 << TWINT)))
+            return;         // Writing TWINT = 1 starts the operation
+        sim.twint = 0;
+        if (value & (1 << TWSTO))
+        {
+            sim.stops++;
+            sim.owned = 0;
+            sim.status = 0xf8;
+        }
+        if (value & (1 << TWSTA))
+            sim_start();
+        else if (!(value & (1 << TWSTO)))
+            sim_data(value & (1 << TWEA));
+        break;
+    case TWI_SIM_TWSR:
+        sim.twps = value & 0x03;
+        break;
+    case TWI_SIM_TWDR:
+        sim.twdr = value;
+        break;
+    default:
+        sim.twbr = value;
+        break;
+    }
+}
+
+void twi_sim_line(uint8_t pin, uint8_t level)
+{
+    if (pin == TWI_SCL_PIN)
+    {
+        if (level && !sim.scl)
+        {
+            sim.scl_pulses++;
+            if (sim.sda_stuck && --sim.sda_stuck == 0)
+                sim.sda = 1;    // Slave finished its byte
+        }
+        sim.scl = level;
+    }
+    else
+    {
+        if (level && !sim.sda && sim.scl && !sim.sda_stuck)
+            sim.line_stops++;
+        sim.sda = level && !sim.sda_stuck;
+    }
+}
+
+
+/* Time base of the wait and latency statistics: simulated time */
+uint32_t systime_us(void)
+{
+    return avr_stub_us;
+}
+
+
+// -- Tests ------------------------------------------------
+void setUp(void)
+{
+    memset(&sim, 0, sizeof(sim));
+    sim.status = 0xf8;
+    sim.scl = sim.sda = 1;
+    twi_set_speed(TWI_SPEED_STANDARD);
+    twi_init();
+}
+
+void tearDown(void)
+{
+}
+
+static void test_write_mem(void)
+{
+    const uint8_t data[] = { 0x11, 0x22, 0x33 };
+    const uint8_t expect[] = { 0x10, 0x11, 0x22, 0x33 };
+
+    TEST_ASSERT_EQUAL(0, twi_writeto_mem(SIM_SLAVE, 0x10, data, 3));
+    TEST_ASSERT_EQUAL(4, sim.wlen);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expect, sim.wlog, 4);
+    TEST_ASSERT_EQUAL(1, sim.starts);
+    TEST_ASSERT_EQUAL(1, sim.stops);
+    TEST_ASSERT_FALSE(twi_busy());
+}
+
+static void test_read_mem_uses_repeated_start(void)
+{
+    volatile uint8_t buf[5];
+    uint8_t i;
+
+    for (i = 0; i < 5; i++)
+        sim.mem[i] = 0xa0 + i;
+
+    TEST_ASSERT_EQUAL(0, twi_readfrom_mem_into(SIM_SLAVE, 0, buf, 5));
+    for (i = 0; i < 5; i++)
+        TEST_ASSERT_EQUAL_HEX8(0xa0 + i, buf[i]);
+    TEST_ASSERT_EQUAL(1, sim.starts);
+    TEST_ASSERT_EQUAL(1, sim.rstarts);
+    TEST_ASSERT_EQUAL(1, sim.stops);
+}
+
+static void test_writev_joins_segments(void)
+{
+    const uint8_t a[] = { 0x40 }, b[] = { 1, 2 }, c[] = { 3 };
+    const twi_iov_t iov[] = { { a, 1 }, { b, 2 }, { NULL, 0 }, { c, 1 } };
+    const uint8_t expect[] = { 0x40, 1, 2, 3 };
+
+    TEST_ASSERT_EQUAL(0, twi_writev(SIM_SLAVE, iov, 4));
+    TEST_ASSERT_EQUAL(4, sim.wlen);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expect, sim.wlog, 4);
+    TEST_ASSERT_EQUAL(1, sim.starts);
+}
+
+static void test_probe(void)
+{
+    TEST_ASSERT_EQUAL(0, twi_test_address(SIM_SLAVE));
+    TEST_ASSERT_EQUAL(1, twi_test_address(0x3c));
+    TEST_ASSERT_EQUAL(2, sim.starts);   // NORETRY: no second attempt
+}
+
+static uint8_t order[4];
+static uint8_t order_len;
+
+static void record(twi_xfer_t *xfer)
+{
+    order[order_len++] = xfer->memaddr;
+}
+
+static void test_queue_serves_high_priority_first(void)
+{
+    static const uint8_t byte = 0;
+    twi_xfer_t x[3];
+    uint8_t i;
+
+    order_len = 0;
+    for (i = 0; i < 3; i++)
+    {
+        x[i] = (twi_xfer_t){
+            .addr = SIM_SLAVE,
+            .prio = (i == 2) ? TWI_PRIO_HIGH : TWI_PRIO_LOW,
+            .flags = TWI_XFER_MEMADDR,
+            .memaddr = i,
+            .wbuf = &byte,
+            .wlen = 1,
+            .callback = record,
+        };
+        TEST_ASSERT_EQUAL(0, twi_submit(&x[i]));
+    }
+
+    // 0 took the idle bus, 2 overtakes the earlier low-priority 1
+    TEST_ASSERT_EQUAL(TWI_XFER_DONE, twi_xfer_wait(&x[1]));
+    TEST_ASSERT_EQUAL(3, order_len);
+    TEST_ASSERT_EQUAL(0, order[0]);
+    TEST_ASSERT_EQUAL(2, order[1]);
+    TEST_ASSERT_EQUAL(1, order[2]);
+}
+
+static void test_wait_and_latency_in_us(void)
+{
+    static const uint8_t data[8] = { 0 };
+    twi_xfer_t a = { .addr = SIM_SLAVE, .wbuf = data, .wlen = 8 };
+    twi_xfer_t b = { .addr = SIM_SLAVE, .wbuf = data, .wlen = 1 };
+    twi_stats_t qs;
+    twi_dev_stats_t st;
+    uint32_t t0;
+
+    twi_reset_stats();
+    t0 = avr_stub_us;
+    twi_submit(&a);
+    twi_submit(&b);                     // Waits behind a
+    twi_xfer_wait(&b);
+
+    twi_get_stats(&qs);
+    TEST_ASSERT_GREATER_THAN(0, qs.max_wait[TWI_PRIO_HIGH]);
+    TEST_ASSERT_LESS_OR_EQUAL(avr_stub_us - t0, qs.max_wait[TWI_PRIO_HIGH]);
+    twi_get_device_stats(SIM_SLAVE, &st);
+    TEST_ASSERT_EQUAL(2, st.transfers);
+    // b: its queue wait plus its own transfer
+    TEST_ASSERT_GREATER_THAN(qs.max_wait[TWI_PRIO_HIGH], st.max_latency);
+    TEST_ASSERT_LESS_OR_EQUAL(avr_stub_us - t0, st.max_latency);
+}
+
+static void test_device_speed_set_at_start(void)
+{
+    const uint8_t byte = 0;
+
+    TEST_ASSERT_EQUAL(0, twi_set_device_speed(SIM_SLAVE, TWI_SPEED_FAST));
+    twi_writeto_mem(SIM_SLAVE, 0, &byte, 1);
+    TEST_ASSERT_EQUAL(12, sim.start_twbr);      // 16 MHz / (16 + 2*12) = 400 kHz
+
+    twi_set_device_speed(SIM_SLAVE, 0);
+    twi_writeto_mem(SIM_SLAVE, 0, &byte, 1);
+    TEST_ASSERT_EQUAL(72, sim.start_twbr);      // 100 kHz default
+}
+
+static void test_bit_rate_limits(void)
+{
+    twi_set_speed(0);                           // no division by zero
+    TEST_ASSERT_EQUAL(255, sim.twbr);
+    twi_set_speed(1000);                        // below ~31 kHz
+    TEST_ASSERT_EQUAL(255, sim.twbr);
+    twi_set_speed(F_CPU);                       // F_CPU / scl < 16, no underflow
+    TEST_ASSERT_EQUAL(10, sim.twbr);
+    twi_set_speed(0xFFFFFFFFUL);
+    TEST_ASSERT_EQUAL(10, sim.twbr);
+    twi_set_speed(TWI_SPEED_STANDARD);
+    TEST_ASSERT_EQUAL(72, sim.twbr);
+}
+
+static void test_address_nack_fails_after_retries(void)
+{
+    const uint8_t byte = 0;
+    twi_dev_stats_t st;
+
+    twi_reset_stats();
+    sim.nack_addr = 255;
+    TEST_ASSERT_EQUAL(1, twi_writeto_mem(SIM_SLAVE, 0, &byte, 1));
+    TEST_ASSERT_EQUAL(1 + TWI_RETRIES, sim.starts + sim.rstarts);
+    TEST_ASSERT_EQUAL(0, twi_get_device_stats(SIM_SLAVE, &st));
+    TEST_ASSERT_EQUAL(1, st.transfers);
+    TEST_ASSERT_EQUAL(1, st.errors);
+    TEST_ASSERT_EQUAL(TWI_RETRIES, st.retries);
+    TEST_ASSERT_FALSE(twi_busy());
+}
+
+static void test_data_nack_retried(void)
+{
+    const uint8_t data[] = { 7, 8 };
+    twi_dev_stats_t st;
+
+    twi_reset_stats();
+    sim.nack_data = 1;
+    TEST_ASSERT_EQUAL(0, twi_writeto_mem(SIM_SLAVE, 0x20, data, 2));
+    TEST_ASSERT_EQUAL(7, sim.mem[0x20]);
+    TEST_ASSERT_EQUAL(8, sim.mem[0x21]);
+    twi_get_device_stats(SIM_SLAVE, &st);
+    TEST_ASSERT_EQUAL(0, st.errors);
+    TEST_ASSERT_EQUAL(1, st.retries);
+}
+
+static void test_arbitration_lost_retried(void)
+{
+    volatile uint8_t buf[2];
+    twi_dev_stats_t st;
+
+    twi_reset_stats();
+    sim.mem[4] = 0x5a;
+    sim.mem[5] = 0xa5;
+    sim.arb_lost = 1;
+    TEST_ASSERT_EQUAL(0, twi_readfrom_mem_into(SIM_SLAVE, 4, buf, 2));
+    TEST_ASSERT_EQUAL_HEX8(0x5a, buf[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xa5, buf[1]);
+    twi_get_device_stats(SIM_SLAVE, &st);
+    TEST_ASSERT_EQUAL(1, st.retries);
+}
+
+static void test_stuck_sda_recovered(void)
+{
+    const uint8_t byte = 0x99;
+    twi_stats_t qs;
+    twi_dev_stats_t st;
+    uint32_t t0 = avr_stub_us;
+
+    twi_reset_stats();
+    sim.sda_stuck = 5;
+    sim.sda = 0;
+    TEST_ASSERT_EQUAL(1, twi_writeto_mem(SIM_SLAVE, 0, &byte, 1));
+
+    // Bounded wait, then 9 clock pulses and a STOP on the released bus
+    TEST_ASSERT_UINT_WITHIN(500, TWI_TIMEOUT_US, avr_stub_us - t0);
+    TEST_ASSERT_EQUAL(9, sim.scl_pulses);
+    TEST_ASSERT_EQUAL(1, sim.line_stops);
+    twi_get_stats(&qs);
+    TEST_ASSERT_EQUAL(1, qs.recoveries);
+    twi_get_device_stats(SIM_SLAVE, &st);
+    TEST_ASSERT_EQUAL(1, st.timeouts);
+    TEST_ASSERT_EQUAL(1, st.errors);
+
+    // The bus works again
+    TEST_ASSERT_EQUAL(0, twi_writeto_mem(SIM_SLAVE, 0x30, &byte, 1));
+    TEST_ASSERT_EQUAL_HEX8(0x99, sim.mem[0x30]);
+}
+
+static void test_watchdog_aborts_stalled_transfer(void)
+{
+    static const uint8_t byte = 0;
+    twi_xfer_t x = {
+        .addr = SIM_SLAVE,
+        .wbuf = &byte,
+        .wlen = 1,
+    };
+
+    sim.sda_stuck = 3;
+    sim.sda = 0;
+    TEST_ASSERT_EQUAL(0, twi_submit(&x));
+    twi_watchdog();                     // Arms on the running transfer
+    TEST_ASSERT_EQUAL(TWI_XFER_PENDING, x.status);
+    twi_watchdog();                     // No progress since: recover
+    TEST_ASSERT_EQUAL(TWI_XFER_ERROR, x.status);
+    TEST_ASSERT_FALSE(twi_busy());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_write_mem);
+    RUN_TEST(test_read_mem_uses_repeated_start);
+    RUN_TEST(test_writev_joins_segments);
+    RUN_TEST(test_probe);
+    RUN_TEST(test_queue_serves_high_priority_first);
+    RUN_TEST(test_wait_and_latency_in_us);
+    RUN_TEST(test_device_speed_set_at_start);
+    RUN_TEST(test_bit_rate_limits);
+    RUN_TEST(test_address_nack_fails_after_retries);
+    RUN_TEST(test_data_nack_retried);
+    RUN_TEST(test_arbitration_lost_retried);
+    RUN_TEST(test_stuck_sda_recovered);
+    RUN_TEST(test_watchdog_aborts_stalled_transfer);
+    return UNITY_END();
+}
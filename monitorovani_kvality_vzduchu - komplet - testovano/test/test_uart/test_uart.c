@@ -0,0 +1,124 @@
+/*
+ * Host tests of uart_tx_busy() against a simulated USART transmitter.
+ *
+ * The transmitter has UDR0 and the shift register: a byte written to
+ * UDR0 moves to the shift register when that is empty, sim_frame()
+ * shifts one frame out, and TXC0 is set when the shift register ends
+ * a frame with UDR0 empty. Writing one to TXC0 clears it; the test
+ * does that after each USART_UDRE_vect call that wrote a byte.
+ */
+
+#define __AVR_ATmega328P__
+#include <unity.h>
+#include "uart.c"
+
+
+// -- Simulated transmitter --------------------------------
+static uint8_t sim_udr_full;        // Byte waiting in UDR0
+static uint8_t sim_shifting;        // Byte in the shift register
+static uint8_t sim_sent;            // Frames shifted out
+
+static void sim_load(void)
+{
+    if (sim_udr_full && !sim_shifting)
+    {
+        sim_udr_full = 0;
+        sim_shifting = 1;
+    }
+}
+
+// UDRE interrupt, if enabled and UDR0 is empty
+static void sim_udre(void)
+{
+    unsigned char tail = UART_TxTail;
+
+    if (sim_udr_full || !(UCSR0B & (1 << UDRIE0)))
+        return;
+    USART_UDRE_vect();
+    if (UART_TxTail != tail)
+    {
+        TEST_ASSERT_TRUE(UCSR0A & (1 << TXC0));     // written one: cleared
+        UCSR0A &= ~(1 << TXC0);
+        sim_udr_full = 1;
+        sim_load();
+    }
+}
+
+// One frame time (87 µs at 115200 Bd)
+static void sim_frame(void)
+{
+    if (!sim_shifting)
+        return;
+    sim_shifting = 0;
+    sim_sent++;
+    sim_load();
+    if (!sim_shifting)
+        UCSR0A |= 1 << TXC0;
+}
+
+
+// -- Tests ------------------------------------------------
+void setUp(void)
+{
+    UCSR0A = UCSR0B = 0;
+    sim_udr_full = sim_shifting = sim_sent = 0;
+    uart_init(UART_BAUD_SELECT_DOUBLE_SPEED(115200, F_CPU));
+}
+
+void tearDown(void) {}
+
+static void test_idle_after_init(void)
+{
+    TEST_ASSERT_EQUAL(0, uart_tx_busy());
+}
+
+static void test_busy_until_last_frame_shifted_out(void)
+{
+    uart_puts("ab");
+    TEST_ASSERT_NOT_EQUAL(0, uart_tx_busy());
+
+    sim_udre();                 // 'a' to the shift register
+    sim_udre();                 // 'b' waits in UDR0
+    sim_frame();                // 'a' out, 'b' shifting
+    sim_udre();                 // buffer empty: UDRE interrupt off
+    TEST_ASSERT_EQUAL(0, UCSR0B & (1 << UDRIE0));
+    TEST_ASSERT_NOT_EQUAL(0, uart_tx_busy());
+
+    sim_frame();                // 'b' out
+    TEST_ASSERT_EQUAL(2, sim_sent);
+    TEST_ASSERT_EQUAL(0, uart_tx_busy());
+}
+
+static void test_txc_from_earlier_byte_does_not_count(void)
+{
+    uart_putc('a');
+    sim_udre();
+    sim_udre();
+    sim_frame();
+    TEST_ASSERT_EQUAL(0, uart_tx_busy());      // TXC set by 'a'
+
+    uart_putc('b');
+    sim_udre();                 // writes 'b', clears TXC
+    sim_udre();
+    TEST_ASSERT_NOT_EQUAL(0, uart_tx_busy());
+    sim_frame();
+    TEST_ASSERT_EQUAL(0, uart_tx_busy());
+}
+
+static void test_txc_clear_keeps_double_speed(void)
+{
+    TEST_ASSERT_TRUE(UCSR0A & (1 << U2X0));
+    uart_putc('a');
+    sim_udre();
+    TEST_ASSERT_TRUE(UCSR0A & (1 << U2X0));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_after_init);
+    RUN_TEST(test_busy_until_last_frame_shifted_out);
+    RUN_TEST(test_txc_from_earlier_byte_does_not_count);
+    RUN_TEST(test_txc_clear_keeps_double_speed);
+    return UNITY_END();
+}